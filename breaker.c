@@ -0,0 +1,191 @@
+/**
+ * @file breaker.c
+ * @brief Src file of module with circuit breaker, that remembers failures
+ * of hosts across runs (in the state file) and skips hosts, that are
+ * repeatedly unreachable
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 11. 11. 2022
+ */
+
+#include "breaker.h"
+
+
+/**
+ * @brief Parses one line of the state file and stores the host to the table
+ */
+void breaker_load_line(breaker_t *breaker, char *line, int64_t now) {
+    char fmt[64];
+    snprintf(fmt, sizeof(fmt), "%%%ds %%%ds %%ld %%d %%" SCNd64 " %%" SCNd64 " %%" SCNd64, MAX_HOST_LEN, MAX_PORT_LEN);
+
+    char host[MAX_HOST_LEN + 1], port[MAX_PORT_LEN + 1];
+    breaker_entry_t loaded;
+    if(sscanf(line, fmt, host, port, &(loaded.failures), &(loaded.last_error),
+              &(loaded.failed_at), &(loaded.probe_at), &(loaded.interval)) != 7) {
+        breaker->dirty = true; //< Malformed line is dropped from the state file
+        return;
+    }
+
+    bool is_valid = loaded.failures > 0 && (loaded.last_error == CONNECTION_ERROR || loaded.last_error == COMMUNICATION_ERROR) &&
+                    loaded.probe_at >= 0 && loaded.interval >= 0;
+    if(!is_valid || now - loaded.failed_at > BREAKER_FORGET_S) { //< Old failures are forgotten
+        breaker->dirty = true;
+        return;
+    }
+
+    breaker_entry_t *entry = (breaker_entry_t *)host_tab_get(&(breaker->tab), host, port, true);
+    if(entry) {
+        entry->failures = loaded.failures;
+        entry->last_error = loaded.last_error;
+        entry->failed_at = loaded.failed_at;
+        entry->probe_at = loaded.probe_at;
+        entry->interval = loaded.interval;
+    }
+}
+
+
+void breaker_init(breaker_t *breaker, char *path) {
+    host_tab_init(&(breaker->tab), sizeof(breaker_entry_t));
+    breaker->path = path;
+    breaker->dirty = false;
+
+    if(!path) {
+        return;
+    }
+
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        if(errno != ENOENT) { //< Missing file means, that there are no failures yet
+            printw("Nepodarilo se nacist stav serveru ze souboru '%s'!", path);
+        }
+
+        return;
+    }
+
+    int64_t now = (int64_t)time(NULL);
+    char line[BREAKER_LINE_SIZE];
+    while(fgets(line, BREAKER_LINE_SIZE, f)) {
+        if(line[0] != '#') {
+            breaker_load_line(breaker, line, now);
+        }
+    }
+
+    fclose(f);
+}
+
+
+bool breaker_is_open(breaker_t *breaker, const char *host, const char *port) {
+    if(!breaker->path) {
+        return false;
+    }
+
+    breaker_entry_t *entry = (breaker_entry_t *)host_tab_get(&(breaker->tab), host, port, false);
+    return entry && entry->probe_at && (int64_t)time(NULL) < entry->probe_at;
+}
+
+
+bool breaker_allow(breaker_t *breaker, const char *host, const char *port, int *err, long *failures) {
+    if(!breaker_is_open(breaker, host, port)) { //< Circuit is closed or probe is allowed (it is evaluated by breaker_record)
+        return true;
+    }
+
+    breaker_entry_t *entry = (breaker_entry_t *)host_tab_get(&(breaker->tab), host, port, false);
+    *err = entry->last_error;
+    *failures = entry->failures;
+
+    return false;
+}
+
+
+void breaker_record(breaker_t *breaker, const char *host, const char *port, int result) {
+    if(!breaker->path) {
+        return;
+    }
+
+    int64_t now = (int64_t)time(NULL);
+    if(result != CONNECTION_ERROR && result != COMMUNICATION_ERROR) { //< Host responded (even HTTP error means, that host is alive)
+        breaker_entry_t *entry = (breaker_entry_t *)host_tab_get(&(breaker->tab), host, port, false);
+        if(entry && entry->failures) {
+            entry->failures = 0;
+            entry->probe_at = 0;
+            entry->interval = 0;
+            breaker->dirty = true;
+        }
+
+        return;
+    }
+
+    breaker_entry_t *entry = (breaker_entry_t *)host_tab_get(&(breaker->tab), host, port, true);
+    if(!entry) {
+        return;
+    }
+
+    entry->last_error = result;
+    entry->failed_at = now;
+    breaker->dirty = true;
+
+    if(entry->probe_at) { //< Probe failed, the next one will be performed later
+        entry->interval = entry->interval*2 < BREAKER_PROBE_MAX_S ? entry->interval*2 : BREAKER_PROBE_MAX_S;
+        entry->interval = entry->interval > BREAKER_PROBE_MIN_S ? entry->interval : BREAKER_PROBE_MIN_S;
+        entry->probe_at = now + entry->interval;
+    }
+
+    if(entry->counted) { //< Other sources (or repeated attempts) of the same run are not counted
+        return;
+    }
+
+    entry->counted = true;
+    entry->failures++;
+
+    if(!entry->probe_at && entry->failures >= BREAKER_THRESHOLD) {
+        entry->interval = BREAKER_PROBE_MIN_S;
+        entry->probe_at = now + entry->interval;
+        printw("Server '%s' byl nedostupny pri %ld po sobe jdoucich behech, jeho zdroje budou preskakovany (dalsi pokus za %" PRId64 " s)",
+            host, entry->failures, entry->interval);
+    }
+}
+
+
+int breaker_save(breaker_t *breaker) {
+    if(!breaker->path || !breaker->dirty) {
+        return SUCCESS;
+    }
+
+    char tmp_path[FILENAME_MAX];
+    if(snprintf(tmp_path, FILENAME_MAX, "%s.tmp", breaker->path) >= FILENAME_MAX) {
+        printw("Nepodarilo se ulozit stav serveru do souboru '%s'!", breaker->path);
+        return FILE_ERROR;
+    }
+
+    FILE *f = fopen(tmp_path, "w");
+    if(!f) {
+        printw("Nepodarilo se ulozit stav serveru do souboru '%s'!", breaker->path);
+        return FILE_ERROR;
+    }
+
+    fprintf(f, "%s\n", BREAKER_FILE_HEADER);
+    fprintf(f, "# host port failures last_error failed_at probe_at interval\n");
+    for(size_t i = 0; i < breaker->tab.cap; i++) {
+        host_entry_t *slot = &(breaker->tab.slots[i]);
+        breaker_entry_t *entry = (breaker_entry_t *)slot->data;
+        if(entry && entry->failures) { //< Hosts without failures are not stored
+            fprintf(f, "%s %s %ld %d %" PRId64 " %" PRId64 " %" PRId64 "\n", slot->host, slot->port,
+                entry->failures, entry->last_error, entry->failed_at, entry->probe_at, entry->interval);
+        }
+    }
+
+    if(fclose(f) || rename(tmp_path, breaker->path)) { //< Other runs see either old or new state
+        remove(tmp_path);
+        printw("Nepodarilo se ulozit stav serveru do souboru '%s'!", breaker->path);
+        return FILE_ERROR;
+    }
+
+    breaker->dirty = false;
+
+    return SUCCESS;
+}
+
+
+void breaker_dtor(breaker_t *breaker) {
+    host_tab_dtor(&(breaker->tab));
+}
@@ -0,0 +1,110 @@
+/**
+ * @file breaker.h
+ * @brief Header file of module with circuit breaker, that remembers failures
+ * of hosts across runs (in the state file) and skips hosts, that are
+ * repeatedly unreachable
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 11. 11. 2022
+ */
+
+#ifndef _FEEDREADER_BREAKER_
+#define _FEEDREADER_BREAKER_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "common.h"
+#include "cli.h"
+#include "url.h"
+
+
+#define BREAKER_THRESHOLD 3 //< Amount of consecutive runs with failure of host, after which the circuit is opened
+#define BREAKER_PROBE_MIN_S 600 //< Time in seconds, after which the first probe of host with open circuit is allowed
+#define BREAKER_PROBE_MAX_S 86400 //< Upper bound of time between probes (it is doubled after each failed probe)
+#define BREAKER_FORGET_S (7*86400) //< Hosts, that have not failed for this time, are removed from the state file
+
+#define BREAKER_FILE_HEADER "# feedreader host state v1" //< The first line of the state file
+#define BREAKER_LINE_SIZE 512 //< Maximum length of line of the state file
+
+
+/**
+ * @brief Failures of one host
+ */
+typedef struct breaker_entry {
+    long failures; //< Amount of consecutive failures (at most one failure is counted in one run)
+    int last_error; //< Result code of the last failure
+    int64_t failed_at; //< Time of the last failure (in seconds of real time clock)
+    int64_t probe_at; //< Time, when the next attempt is allowed (0 if circuit is closed)
+    int64_t interval; //< Time between probes of open circuit
+    bool counted; //< Flag signalizing, that failure of host in the current run was already counted
+} breaker_entry_t;
+
+
+/**
+ * @brief Circuit breaker with failures of hosts
+ * @note It is not thread safe (it is used only by the thread, that fetches sources)
+ */
+typedef struct breaker {
+    host_tab_t tab; //< Table with failures of hosts (breaker_entry_t)
+    char *path; //< Path to the state file (or NULL if state is not persistent)
+    bool dirty; //< Flag signalizing, that state was changed and it should be saved
+} breaker_t;
+
+
+/**
+ * @brief Initializes circuit breaker and loads the state file (missing file
+ * means empty state, invalid lines are ignored)
+ *
+ * @param path Path to the state file or NULL (then the breaker does nothing)
+ */
+void breaker_init(breaker_t *breaker, char *path);
+
+
+/**
+ * @brief Checks whether the circuit of the host is open and the next probe is
+ * not allowed yet (state of the breaker is not changed)
+ */
+bool breaker_is_open(breaker_t *breaker, const char *host, const char *port);
+
+
+/**
+ * @brief Decides whether the request to the host may be sent
+ *
+ * @param err Output parameter for the result code of the last failure of host (if it is not allowed)
+ * @param failures Output parameter for the amount of consecutive failures of host
+ * @return true if the request may be sent (circuit is closed or the probe is allowed)
+ */
+bool breaker_allow(breaker_t *breaker, const char *host, const char *port, int *err, long *failures);
+
+
+/**
+ * @brief Records the result of the request to the host (only connection and
+ * communication errors are considered as failures of host)
+ */
+void breaker_record(breaker_t *breaker, const char *host, const char *port, int result);
+
+
+/**
+ * @brief Writes the state to the file (if it was changed), the file is
+ * replaced atomically
+ *
+ * @return int SUCCESS or FILE_ERROR
+ */
+int breaker_save(breaker_t *breaker);
+
+
+/**
+ * @brief Frees resources of the breaker (state is not saved)
+ */
+void breaker_dtor(breaker_t *breaker);
+
+
+#endif
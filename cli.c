@@ -9,8 +9,42 @@
 #include "cli.h"
 
 
+/**
+ * @brief Names of long options, that set timeouts (indexed by timeouts enum)
+ */
+const char *timeout_opts[TO_NUM] = {
+    "dns-timeout",
+    "connect-timeout",
+    "tls-timeout",
+    "first-byte-timeout",
+    "feed-timeout",
+    "run-timeout",
+};
+
+
+/**
+ * @brief Names of long options, that set limits of rates (indexed by limits enum)
+ */
+const char *limit_opts[LIM_NUM] = {
+    "rate-limit",
+    "request-rate",
+    "host-rate-limit",
+    "host-request-rate",
+};
+
+
+/**
+ * @brief The last error message printed by the current thread (see last_err)
+ */
+_Thread_local char last_err_msg[MAX_KEPT_ERR_LEN + 1];
+
+
 void init_settings(settings_t *settings) {
     memset(settings, 0, sizeof(settings_t));
+
+    long default_timeouts[TO_NUM] = DEFAULT_TIMEOUTS;
+    memcpy(settings->timeouts, default_timeouts, sizeof(default_timeouts));
+    settings->retries = DEFAULT_RETRIES;
 }
 
 
@@ -33,14 +67,29 @@ void printerr(int err_code, const char *message_format,...) {
 
     if(message_format) { //< Print the message
         va_list args;
-        va_start (args, message_format);
+        va_start(args, message_format);
+        vsnprintf(last_err_msg, sizeof(last_err_msg), message_format, args); //< Message is kept for replaying
+        va_end(args);
+
+        va_start(args, message_format);
         vfprintf(stderr, message_format, args);
+        va_end(args);
     }
 
     fprintf(stderr, "\n");
 }
 
 
+const char *last_err() {
+    return last_err_msg;
+}
+
+
+void clear_last_err() {
+    last_err_msg[0] = '\0';
+}
+
+
 void printw(const char *message_format,...) {
     #ifdef CLI_WARNINGS
     
@@ -60,7 +109,7 @@ void printw(const char *message_format,...) {
 
 void print_usage() {
     const char *usage_msg = 
-        "USAGE: ./feedreader <URL|-f <feedfile>> [options]\n";
+        "USAGE: ./feedreader <URL|-f <feedfile>|-d <feeddir>> [options]\n";
 
     fprintf(stdout, "%s\n", usage_msg);
 }
@@ -73,12 +122,34 @@ void print_help() {
     const char *option_msg = 
         "options:\n"
         "-h, --help     Vypise na napovedu na stdout\n"
-        "-f feedfile    Specifikuje cestu k souboru s URL vedoucich ke zdrojum Atom/RSS\n"
+        "-f feedfile    Specifikuje cestu k souboru s URL vedoucich ke zdrojum Atom/RSS ('-' pro stdin)\n"
+        "-d feeddir     Specifikuje slozku (nebo glob vzor) s lokalnimi soubory Atom/RSS (zpracovany paralelne)\n"
         "-c certfile    Specifikuje cestu k souboru s certifikatem\n"
         "-C certaddr    Specifikuje slozku ke slozce s certifikaty\n"
         "-T             Prida informaci o aktualizace na vystup programu\n"
         "-u             Prida asociovanou URL na vystup programu\n"
-        "-a             Prida jmenu autora na vystup programu\n";
+        "-a             Prida jmenu autora na vystup programu\n"
+        "--dns-timeout ms         Maximalni doba prekladu jmena serveru (vychozi 5000)\n"
+        "--connect-timeout ms     Maximalni doba navazani TCP spojeni (vychozi 5000)\n"
+        "--tls-timeout ms         Maximalni doba TLS handshake (vychozi 5000)\n"
+        "--first-byte-timeout ms  Maximalni doba od odeslani zadosti do prvniho bajtu odpovedi (vychozi 10000)\n"
+        "--feed-timeout ms        Maximalni doba stahovani jednoho zdroje vcetne presmerovani (vychozi bez omezeni)\n"
+        "--run-timeout ms         Maximalni doba behu celeho programu (vychozi bez omezeni)\n"
+        "                         (hodnota 0 vypne dane omezeni)\n"
+        "--hedge                  Pokud server neodpovi do 90. percentilu svych dosavadnich odezev, je odeslan\n"
+        "                         druhy pozadavek (pouzije se rychlejsi odpoved)\n"
+        "--retries n              Maximalni pocet opakovani nacteni zdroje po chybe spojeni nebo komunikace\n"
+        "                         (vychozi 0, opakovani jsou odlozena, mezitim se zpracovavaji dalsi zdroje,\n"
+        "                         neprelozitelne servery nejsou opakovany)\n"
+        "--host-state file        Soubor se stavem serveru, servery nedostupne pri 3 po sobe jdoucich behech\n"
+        "                         jsou preskakovany (s chybou z posledniho pokusu) a jen obcas znovu zkouseny\n"
+        "--redirect-memo file     Soubor s trvalymi presmerovanimi (301, 308), ktera jsou po dobu 24 h\n"
+        "                         pouzita bez dotazu na puvodni adresu\n"
+        "--rate-limit B           Maximalni pocet prenesenych bajtu za sekundu (vychozi bez omezeni)\n"
+        "--request-rate n         Maximalni pocet HTTP zadosti za sekundu (vychozi bez omezeni)\n"
+        "--host-rate-limit B      Maximalni pocet prenesenych bajtu za sekundu pro jeden server\n"
+        "--host-request-rate n    Maximalni pocet HTTP zadosti za sekundu pro jeden server\n"
+        "--limit-file file        Soubor se stavem omezeni sdilenym vice soucasne bezicimi instancemi\n";
 
     fprintf(stdout, "%s\n", about_msg);
     print_usage();
@@ -122,6 +193,10 @@ int rec_opt(char opt_char, opt_t *opt, settings_t *s) {
             opt->name = "f";
             opt->arg = &s->feedfile;
             break;
+        case 'd':
+            opt->name = "d";
+            opt->arg = &s->feeddir;
+            break;
         case 'c':
             opt->name = "c";
             opt->arg = &s->certfile;
@@ -160,9 +235,46 @@ int rec_lopt(char *cur_opt, int *char_i, opt_t *opt, settings_t *s) {
         opt->name = "help";
         opt->flag = &s->help_flag;
     }
-    else { //< Long option was not recognized
-        printerr(USAGE_ERROR, "Neznamy prepinac: --%s!", opt_str);
-        return USAGE_ERROR;
+    else if(!strcmp(opt_str, "hedge")) {
+        opt->name = "hedge";
+        opt->flag = &s->hedge_flag;
+    }
+    else if(!strcmp(opt_str, "retries")) {
+        opt->name = "retries";
+        opt->arg = &s->retries_arg;
+    }
+    else if(!strcmp(opt_str, "host-state")) {
+        opt->name = "host-state";
+        opt->arg = &s->state_file;
+    }
+    else if(!strcmp(opt_str, "redirect-memo")) {
+        opt->name = "redirect-memo";
+        opt->arg = &s->redir_file;
+    }
+    else if(!strcmp(opt_str, "limit-file")) {
+        opt->name = "limit-file";
+        opt->arg = &s->limit_file;
+    }
+    else {
+        for(int i = 0; i < TO_NUM; i++) { //< Timeout options
+            if(!strcmp(opt_str, timeout_opts[i])) {
+                opt->name = (char *)timeout_opts[i];
+                opt->arg = &s->timeout_args[i];
+                break;
+            }
+        }
+
+        for(int i = 0; i < LIM_NUM && !opt->arg; i++) { //< Limit options
+            if(!strcmp(opt_str, limit_opts[i])) {
+                opt->name = (char *)limit_opts[i];
+                opt->arg = &s->limit_args[i];
+            }
+        }
+
+        if(!opt->arg) { //< Long option was not recognized
+            printerr(USAGE_ERROR, "Neznamy prepinac: --%s!", opt_str);
+            return USAGE_ERROR;
+        }
     }
 
     *char_i = strlen("--") + strlen(opt_str);
@@ -230,6 +342,78 @@ int set_values(int argc, char **argv, int *opt_i, char *start, opt_t *option) {
 }
 
 
+/**
+ * @brief Converts arguments of timeout options to numbers
+ * 
+ * @return SUCCESS if all given arguments are non-negative integers, otherwise USAGE_ERROR
+ */
+int parse_timeouts(settings_t *s) {
+    for(int i = 0; i < TO_NUM; i++) {
+        if(!s->timeout_args[i]) { //< Default value is used
+            continue;
+        }
+
+        char *end;
+        errno = 0;
+        long value = strtol(s->timeout_args[i], &end, 10);
+        if(errno || end == s->timeout_args[i] || *end || value < 0) {
+            printerr(USAGE_ERROR, "Neplatna hodnota prepinace '--%s' (ocekava se pocet ms)!", timeout_opts[i]);
+            return USAGE_ERROR;
+        }
+
+        s->timeouts[i] = value;
+    }
+
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Converts arguments of limit options to numbers
+ */
+int parse_limits(settings_t *s) {
+    for(int i = 0; i < LIM_NUM; i++) {
+        if(!s->limit_args[i]) { //< Rate is not limited
+            continue;
+        }
+
+        char *end;
+        errno = 0;
+        long value = strtol(s->limit_args[i], &end, 10);
+        if(errno || end == s->limit_args[i] || *end || value < 0) {
+            printerr(USAGE_ERROR, "Neplatna hodnota prepinace '--%s' (ocekava se pocet za sekundu)!", limit_opts[i]);
+            return USAGE_ERROR;
+        }
+
+        s->limits[i] = value;
+    }
+
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Converts argument of retries option to the number
+ */
+int parse_retries(settings_t *s) {
+    if(!s->retries_arg) { //< Default value is used
+        return SUCCESS;
+    }
+
+    char *end;
+    errno = 0;
+    long value = strtol(s->retries_arg, &end, 10);
+    if(errno || end == s->retries_arg || *end || value < 0 || value > MAX_RETRIES) {
+        printerr(USAGE_ERROR, "Neplatna hodnota prepinace '--retries' (ocekava se cislo od 0 do %d)!", MAX_RETRIES);
+        return USAGE_ERROR;
+    }
+
+    s->retries = value;
+
+    return SUCCESS;
+}
+
+
 int parse_opts(int argc, char **argv, settings_t *settings) {
 
     for(int i = 1; i < argc; i++) { //< Skip the first argument (it is the program name)
@@ -279,5 +463,14 @@ int parse_opts(int argc, char **argv, settings_t *settings) {
         }
     }
 
-    return SUCCESS;
+    int ret = parse_timeouts(settings);
+    if(ret != SUCCESS) {
+        return ret;
+    }
+
+    if((ret = parse_retries(settings)) != SUCCESS) {
+        return ret;
+    }
+
+    return parse_limits(settings);
 }
\ No newline at end of file
@@ -17,6 +17,8 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stdint.h>
+#include <errno.h>
 
 
 #define PROGNAME "feedreader" //< The name of the program for better filtering of error/warning messages
@@ -45,15 +47,60 @@ enum err_codes {
 };
 
 
+/**
+ * @brief Phases of fetching of the source (and the whole run), that are
+ * limited by timeouts (they can be set by long options)
+ */
+enum timeouts {
+    TO_DNS, //< Resolution of the host
+    TO_CONNECT, //< Establishing of TCP connection (all attempts together)
+    TO_TLS, //< TLS handshake
+    TO_FIRST_BYTE, //< Time between sending of the request and the first byte of the response
+    TO_FEED, //< Total time of fetching of one source from feedfile (including redirections)
+    TO_RUN, //< Total time of the whole run of program
+    TO_NUM, //< Amount of timeouts
+};
+
+
+#define DEFAULT_TIMEOUTS {5000, 5000, 5000, 10000, 0, 0} //< Default values of timeouts in ms (0 means no timeout)
+
+/**
+ * @brief Limits of rates of requests and transferred bytes (they can be set by long options)
+ */
+enum limits {
+    LIM_BYTES, //< Total amount of sent and received bytes per second
+    LIM_REQS, //< Total amount of requests per second
+    LIM_HOST_BYTES, //< Amount of sent and received bytes per second for one host
+    LIM_HOST_REQS, //< Amount of requests per second for one host
+    LIM_NUM, //< Amount of limits
+};
+
+
+#define DEFAULT_RETRIES 0 //< Default maximum amount of repeated attempts to fetch source after transient failure
+#define MAX_RETRIES 10 //< Upper bound of the value of retries option
+
+#define MAX_KEPT_ERR_LEN 512 //< Maximum length of the last error message, that is kept for replaying (longer messages are truncated)
+
+
 /**
  * @brief Structure with information about arguments of the program 
  * in program-firendly format (e. g. the result of the options parsing)
  * 
  */
 typedef struct settings {
-    char *url, *feedfile; //< Options with argument (or it is single argument of program - such as url)
+    char *url, *feedfile, *feeddir; //< Options with argument (or it is single argument of program - such as url)
     char *certfile, *certaddr;
-    bool time_flag, author_flag, asoc_url_flag, help_flag; //< Options without arguments
+    char *state_file; //< Path to the file with failures of hosts (or NULL if failures are not remembered)
+    char *redir_file; //< Path to the file with permanent redirections (or NULL if they are not remembered)
+    bool time_flag, author_flag, asoc_url_flag, help_flag, hedge_flag; //< Options without arguments
+    char *timeout_args[TO_NUM]; //< Arguments of timeout options (in ms)
+    long timeouts[TO_NUM]; //< Timeouts in ms (0 means no timeout), they are converted from arguments by parse_opts
+    char *limit_args[LIM_NUM]; //< Arguments of limit options
+    long limits[LIM_NUM]; //< Limits of rates (0 means no limit), they are converted from arguments by parse_opts
+    char *limit_file; //< Path to the file with state of limits shared by more instances (or NULL)
+    char *retries_arg; //< Argument of retries option
+    long retries; //< Maximum amount of repeated attempts after connection or communication error (converted by parse_opts)
+    uint64_t run_deadline, feed_deadline; //< Absolute deadlines of the whole run and current source in ms of monotonic clock (0 means no deadline)
 } settings_t;
 
 
@@ -79,7 +126,22 @@ void init_settings(settings_t *settings);
  * @param message Auxiliary format of message of the error
  * @param ... 
  */
-void printerr(int err_code, const char *message,...);
+void printerr(int err_code, const char *message,...) __attribute__((format(printf, 2, 3)));
+
+
+/**
+ * @brief Returns the last error message (without headers), that was printed
+ * by printerr in the current thread since the last call of clear_last_err
+ * 
+ * @return const char* Message or empty string
+ */
+const char *last_err();
+
+
+/**
+ * @brief Forgets the last error message of the current thread
+ */
+void clear_last_err();
 
 
 /**
@@ -88,7 +150,7 @@ void printerr(int err_code, const char *message,...);
  * @param message Format of message of the warning
  * @param ... 
  */
-void printw(const char *message,...);
+void printw(const char *message,...) __attribute__((format(printf, 1, 2)));
 
 
 /**
@@ -8,6 +8,7 @@
  */
 
 #include "common.h"
+#include "cli.h"
 
 
 
@@ -68,104 +69,300 @@ bool is_line_empty(char *line_start_ptr) {
 }
 
 
-list_el_t *new_element(char *str_content) {
-    list_el_t *new = (list_el_t *)malloc(sizeof(list_el_t));
-    if(!new) { //< Allocation error
+void url_tab_init(url_tab_t *tab) {
+    memset(tab, 0, sizeof(url_tab_t));
+    arena_init(&(tab->strs));
+}
+
+
+void url_tab_dtor(url_tab_t *tab) {
+    arena_dtor(&(tab->strs));
+    free(tab->url);
+    free(tab->indirect_lvl);
+    free(tab->result);
+    free(tab->redir);
+
+    url_tab_init(tab);
+}
+
+
+void url_tab_reset(url_tab_t *tab) {
+    arena_reset(&(tab->strs));
+    tab->num = 0;
+}
+
+
+void url_cache_init(url_cache_t *cache) {
+    memset(cache, 0, sizeof(url_cache_t));
+    arena_init(&(cache->strs));
+}
+
+
+void url_cache_dtor(url_cache_t *cache) {
+    for(size_t i = 0; i < cache->cap; i++) {
+        free(cache->slots[i].out);
+    }
+
+    free(cache->slots);
+    arena_dtor(&(cache->strs));
+
+    url_cache_init(cache);
+}
+
+
+uint64_t hash_str(const char *str, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+uint64_t mono_ms() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec*1000 + (uint64_t)now.tv_nsec/1000000;
+}
+
+
+/**
+ * @brief Returns slot with given key or the empty slot, where the key should be
+ */
+url_cache_entry_t *url_cache_slot(url_cache_entry_t *slots, size_t cap, const char *key, size_t len, uint64_t hash) {
+    size_t i = hash & (cap - 1);
+    while(slots[i].key) { //< Linear probing (table is never full)
+        if(slots[i].hash == hash && slots[i].key_len == len && !memcmp(slots[i].key, key, len)) {
+            break;
+        }
+
+        i = (i + 1) & (cap - 1);
+    }
+
+    return &(slots[i]);
+}
+
+
+/**
+ * @brief Doubles the capacity of the cache and moves all entries to the new slots
+ */
+bool url_cache_ext(url_cache_t *cache) {
+    size_t new_cap = cache->cap ? cache->cap*2 : INIT_URL_CACHE_CAP;
+    url_cache_entry_t *new_slots = (url_cache_entry_t *)calloc(new_cap, sizeof(url_cache_entry_t));
+    if(!new_slots) {
+        return false;
+    }
+
+    for(size_t i = 0; i < cache->cap; i++) {
+        url_cache_entry_t *old = &(cache->slots[i]);
+        if(old->key) {
+            *url_cache_slot(new_slots, new_cap, old->key, old->key_len, old->hash) = *old;
+        }
+    }
+
+    free(cache->slots);
+    cache->slots = new_slots;
+    cache->cap = new_cap;
+
+    return true;
+}
+
+
+url_cache_entry_t *url_cache_find(url_cache_t *cache, const char *key, size_t len) {
+    if(cache->num == 0) {
         return NULL;
     }
 
-    new->string = new_string(strlen(str_content) + 1); //< Content + '\0'
-    if(!new->string) {
-        free(new);
+    url_cache_entry_t *entry = url_cache_slot(cache->slots, cache->cap, key, len, hash_str(key, len));
+
+    return entry->key ? entry : NULL;
+}
+
+
+url_cache_entry_t *url_cache_insert(url_cache_t *cache, const char *key, size_t len) {
+    if((cache->num + 1)*2 > cache->cap && !url_cache_ext(cache)) { //< Load factor is kept under 0.5
         return NULL;
     }
 
-    if(!(new->string = set_string(&(new->string), str_content))) {
-        free(new);
+    char *key_copy = arena_strndup(&(cache->strs), key, len);
+    if(!key_copy) {
         return NULL;
     }
 
-    //Initialization
-    new->indirect_lvl = 0;
-    new->result = 0;
-    new->next = NULL;
+    uint64_t hash = hash_str(key, len);
+    url_cache_entry_t *entry = url_cache_slot(cache->slots, cache->cap, key, len, hash);
+    memset(entry, 0, sizeof(url_cache_entry_t));
+    entry->key = key_copy;
+    entry->key_len = len;
+    entry->hash = hash;
+    cache->num++;
 
-    return new;
+    return entry;
 }
 
 
-list_el_t *new_element_non_dup(string_t *content) {
-    list_el_t *new = (list_el_t *)malloc(sizeof(list_el_t));
-    if(!new) { //< Allocation error
-        return NULL;
+void host_tab_init(host_tab_t *tab, size_t data_size) {
+    memset(tab, 0, sizeof(host_tab_t));
+    arena_init(&(tab->mem));
+    tab->data_size = data_size;
+}
+
+
+void host_tab_dtor(host_tab_t *tab) {
+    free(tab->slots);
+    arena_dtor(&(tab->mem));
+
+    host_tab_init(tab, tab->data_size);
+}
+
+
+/**
+ * @brief Computes hash of host and port (host is case insensitive)
+ */
+uint64_t host_hash(const char *host, const char *port) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(size_t i = 0; host[i]; i++) {
+        hash ^= (unsigned char)tolower((unsigned char)host[i]);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash ^ hash_str(port, strlen(port));
+}
+
+
+/**
+ * @brief Returns slot with given host and port or the empty slot, where they should be
+ */
+host_entry_t *host_tab_slot(host_entry_t *slots, size_t cap, const char *host, const char *port, uint64_t hash) {
+    size_t i = hash & (cap - 1);
+    while(slots[i].host) { //< Linear probing (table is never full)
+        if(slots[i].hash == hash && !strcasecmp(slots[i].host, host) && !strcmp(slots[i].port, port)) {
+            break;
+        }
+
+        i = (i + 1) & (cap - 1);
     }
 
-    new->string = content;
+    return &(slots[i]);
+}
+
+
+/**
+ * @brief Doubles the capacity of the table and moves all entries to the new slots
+ */
+bool host_tab_ext(host_tab_t *tab) {
+    size_t new_cap = tab->cap ? tab->cap*2 : INIT_HOST_TAB_CAP;
+    host_entry_t *new_slots = (host_entry_t *)calloc(new_cap, sizeof(host_entry_t));
+    if(!new_slots) {
+        return false;
+    }
+
+    for(size_t i = 0; i < tab->cap; i++) {
+        host_entry_t *old = &(tab->slots[i]);
+        if(old->host) {
+            *host_tab_slot(new_slots, new_cap, old->host, old->port, old->hash) = *old;
+        }
+    }
 
-    //Initialization
-    new->indirect_lvl = 0;
-    new->result = 0;
-    new->next = NULL;
+    free(tab->slots);
+    tab->slots = new_slots;
+    tab->cap = new_cap;
 
-    return new;
+    return true;
 }
 
 
-list_el_t *slice2element(string_slice_t *slice, size_t indir_level) {
-    list_el_t *new = (list_el_t *)malloc(sizeof(list_el_t));
-    if(!new) {
+void *host_tab_get(host_tab_t *tab, const char *host, const char *port, bool create) {
+    if(!tab->num && !create) {
         return NULL;
     }
 
-    new->string = new_string(slice->len + 1); //< Allocation of the new string
-    if(!new->string) {
-        free(new);
+    if(create && (tab->num + 1)*2 > tab->cap && !host_tab_ext(tab)) { //< Load factor is kept under 0.5
         return NULL;
     }
 
-    new->string = set_stringn(&(new->string), slice->st, slice->len); //< Setting value of string to value described by slice (copying part of some buffer) 
-    if(!new->string) {
-        free(new);
+    uint64_t hash = host_hash(host, port);
+    host_entry_t *entry = host_tab_slot(tab->slots, tab->cap, host, port, hash);
+    if(entry->host || !create) {
+        return entry->data;
+    }
+
+    size_t host_len = strlen(host);
+    char *host_copy = arena_strndup(&(tab->mem), host, host_len);
+    char *port_copy = arena_strndup(&(tab->mem), port, strlen(port));
+    void *data = arena_alloc(&(tab->mem), tab->data_size);
+    if(!host_copy || !port_copy || !data) {
         return NULL;
     }
 
-    new->indirect_lvl = indir_level;
-    new->next = NULL;
+    for(size_t i = 0; i < host_len; i++) { //< Host names are case insensitive
+        host_copy[i] = (char)tolower((unsigned char)host_copy[i]);
+    }
+
+    memset(data, 0, tab->data_size);
+    *entry = (host_entry_t){ .host = host_copy, .port = port_copy, .hash = hash, .data = data };
+    tab->num++;
 
-    return new;
+    return data;
 }
 
-void list_init(list_t *list) {
-    list->header = NULL;
-}
 
+/**
+ * @brief Extends all columns of URL table to the given capacity 
+ */
+bool url_tab_ext(url_tab_t *tab, size_t new_cap) {
+    char **url = (char **)realloc(tab->url, sizeof(char *)*new_cap);
+    if(!url) {
+        return false;
+    }
+    tab->url = url;
 
-void list_dtor(list_t *list) {
-    list_el_t *current = list->header;
+    int *indirect_lvl = (int *)realloc(tab->indirect_lvl, sizeof(int)*new_cap);
+    if(!indirect_lvl) {
+        return false;
+    }
+    tab->indirect_lvl = indirect_lvl;
 
-    while(current) { //< Free all elements in the list
-        list_el_t *tmp = current;
-        current = current->next;
+    int *result = (int *)realloc(tab->result, sizeof(int)*new_cap);
+    if(!result) {
+        return false;
+    }
+    tab->result = result;
 
-        string_dtor(tmp->string);
-        free(tmp);
+    size_t *redir = (size_t *)realloc(tab->redir, sizeof(size_t)*new_cap);
+    if(!redir) {
+        return false;
     }
+    tab->redir = redir;
+
+    tab->cap = new_cap; //< Capacity is changed only if all columns were extended
+
+    return true;
 }
 
 
-void list_append(list_t *list, list_el_t *new_element) {
-    list_el_t *current = list->header;
+size_t url_tab_append(url_tab_t *tab, const char *url, size_t len, int indirect_lvl) {
+    if(tab->num == tab->cap) {
+        if(!url_tab_ext(tab, tab->cap ? tab->cap*2 : INIT_URL_TAB_CAP)) {
+            return URL_TAB_NONE;
+        }
+    }
 
-    if(!current) {
-        list->header = new_element; //< It is going to be first element in the list
-        return;
+    char *url_copy = arena_strndup(&(tab->strs), url, len);
+    if(!url_copy) {
+        return URL_TAB_NONE;
     }
 
-    while(current->next) { //< Go to the end of the list
-        current = current->next; 
-    };
+    size_t i = tab->num++;
+    tab->url[i] = url_copy;
+    tab->indirect_lvl[i] = indirect_lvl;
+    tab->result[i] = SUCCESS;
+    tab->redir[i] = URL_TAB_NONE;
 
-    current->next = new_element;
+    return i;
 }
 
 
@@ -376,3 +573,346 @@ void string_dtor(string_t *string) {
     free(string);
 }
 
+
+
+void seg_buff_init(seg_buff_t *buff) {
+    memset(buff, 0, sizeof(seg_buff_t));
+}
+
+
+/**
+ * @brief Takes segment with at least given capacity from the spare blocks
+ * or allocates the new one
+ */
+seg_t *seg_take_size(seg_buff_t *buff, size_t size) {
+    seg_t *seg = buff->spare;
+    if(seg && seg->size >= size) { //< All spare segments are blocks of the same size (see seg_recycle)
+        buff->spare = seg->next;
+        buff->spare_num--;
+    }
+    else {
+        seg = (seg_t *)malloc(sizeof(seg_t) + size + 1); //< Block + '\0'
+        if(!seg) {
+            return NULL;
+        }
+
+        seg->size = size;
+    }
+
+    seg->next = NULL;
+    seg->len = 0;
+    seg->data[0] = '\0';
+
+    return seg;
+}
+
+
+/**
+ * @brief Returns segment to the spare blocks (only SEG_MAX_SPARE blocks are
+ * kept, other segments are freed, so memory of large responses is not held
+ * until the end of the program)
+ */
+void seg_recycle(seg_buff_t *buff, seg_t *seg) {
+    if(seg->size != SEG_BLOCK_SIZE || buff->spare_num >= SEG_MAX_SPARE) {
+        free(seg);
+    }
+    else {
+        seg->next = buff->spare;
+        buff->spare = seg;
+        buff->spare_num++;
+    }
+}
+
+
+/**
+ * @brief Takes segment from the spare segments or allocates the new one
+ */
+seg_t *seg_take(seg_buff_t *buff) {
+    return seg_take_size(buff, SEG_BLOCK_SIZE);
+}
+
+
+size_t seg_iov(seg_buff_t *buff, struct iovec *iov, size_t iov_max) {
+    seg_t *tail = buff->tail;
+    if(!tail || tail->len == tail->size) { //< There is no free space at the end -> add the new segment
+        seg_t *new_seg = seg_take(buff);
+        if(!new_seg) {
+            return 0;
+        }
+
+        if(tail) {
+            tail->next = new_seg;
+        }
+        else {
+            buff->head = new_seg;
+        }
+
+        tail = buff->tail = new_seg;
+    }
+
+    size_t iov_n = 0;
+    iov[iov_n].iov_base = &(tail->data[tail->len]);
+    iov[iov_n++].iov_len = tail->size - tail->len;
+
+    if(iov_max > 1) { //< Offer the next block too (it is linked to the chain by seg_commit if it is used)
+        if(!buff->spare) {
+            seg_t *spare = seg_take(buff);
+            if(!spare) {
+                return 0;
+            }
+
+            buff->spare = spare;
+            buff->spare_num++;
+        }
+
+        iov[iov_n].iov_base = buff->spare->data;
+        iov[iov_n++].iov_len = buff->spare->size;
+    }
+
+    return iov_n;
+}
+
+
+void seg_commit(seg_buff_t *buff, size_t n) {
+    seg_t *tail = buff->tail;
+
+    buff->total += n;
+    while(n > 0) {
+        size_t free_space = tail->size - tail->len;
+        size_t in_tail = n < free_space ? n : free_space;
+
+        tail->len += in_tail;
+        tail->data[tail->len] = '\0'; //< Content is always terminated (there is extra byte in every segment)
+        n -= in_tail;
+
+        if(n > 0) { //< The rest was written to the spare block offered by seg_iov
+            seg_t *next = buff->spare;
+            buff->spare = next->next;
+            buff->spare_num--;
+            next->next = NULL;
+            next->len = 0;
+
+            tail = tail->next = buff->tail = next;
+        }
+    }
+}
+
+
+bool seg_realign(seg_buff_t *buff, size_t off, size_t size) {
+    seg_t *tail = buff->tail;
+    if(!tail || off < buff->total - tail->len || off > buff->total) {
+        return false;
+    }
+
+    size_t tail_off = off - (buff->total - tail->len); //< Offset inside the last segment
+    size_t moved = tail->len - tail_off;
+    seg_t *new_seg = seg_take_size(buff, size > moved ? size : moved);
+    if(!new_seg) {
+        return false;
+    }
+
+    memcpy(new_seg->data, &(tail->data[tail_off]), moved);
+    new_seg->len = moved;
+    new_seg->data[moved] = '\0';
+
+    tail->len = tail_off;
+    tail->data[tail_off] = '\0';
+
+    if(tail->len == 0) { //< Old segment is empty -> replace it by the new one
+        seg_t **link = &(buff->head);
+        while(*link != tail) {
+            link = &((*link)->next);
+        }
+
+        *link = new_seg;
+        seg_recycle(buff, tail);
+    }
+    else {
+        tail->next = new_seg;
+    }
+
+    buff->tail = new_seg;
+
+    return true;
+}
+
+
+bool seg_reserve(seg_buff_t *buff, size_t size) {
+    seg_t *tail = buff->tail;
+    if(tail && tail->size - tail->len >= size) {
+        return true;
+    }
+
+    seg_t *new_seg = seg_take_size(buff, size > SEG_BLOCK_SIZE ? size : SEG_BLOCK_SIZE); //< Small reservations reuse spare blocks
+    if(!new_seg) {
+        return false;
+    }
+
+    if(tail) {
+        tail->next = new_seg;
+    }
+    else {
+        buff->head = new_seg;
+    }
+
+    buff->tail = new_seg;
+
+    return true;
+}
+
+
+char *seg_flatten(seg_buff_t *buff, size_t off, size_t *len) {
+    seg_t *seg = buff->head;
+    while(seg && seg->next && off >= seg->len) { //< Find the segment with the first byte of the view
+        off -= seg->len;
+        seg = seg->next;
+    }
+
+    if(!seg) { //< Buffer is empty
+        *len = 0;
+        return "";
+    }
+
+    if(!seg->next) { //< View is inside one segment -> there is no need to copy anything
+        *len = seg->len - off;
+        return &(seg->data[off]);
+    }
+
+    size_t view_len = seg->len - off;
+    for(seg_t *cur = seg->next; cur; cur = cur->next) {
+        view_len += cur->len;
+    }
+
+    if(buff->flat_size < view_len + 1) { //< Content is not initialized (it is rewritten immediately)
+        char *flat = (char *)realloc(buff->flat, view_len + 1);
+        if(!flat) {
+            return NULL;
+        }
+
+        buff->flat = flat;
+        buff->flat_size = view_len + 1;
+    }
+
+    size_t copied = seg->len - off;
+    memcpy(buff->flat, &(seg->data[off]), copied);
+    for(seg_t *cur = seg->next; cur; cur = cur->next) {
+        memcpy(&(buff->flat[copied]), cur->data, cur->len);
+        copied += cur->len;
+    }
+
+    buff->flat[view_len] = '\0';
+    *len = view_len;
+
+    return buff->flat;
+}
+
+
+void seg_buff_reset(seg_buff_t *buff) {
+    seg_t *seg = buff->head;
+    while(seg) { //< Move the whole chain to the spare segments
+        seg_t *tmp = seg;
+        seg = seg->next;
+
+        seg_recycle(buff, tmp);
+    }
+
+    if(buff->flat_size > SEG_MAX_SPARE*SEG_BLOCK_SIZE) { //< Copy of large content is not kept for the next use
+        free(buff->flat);
+        buff->flat = NULL;
+        buff->flat_size = 0;
+    }
+
+    buff->head = buff->tail = NULL;
+    buff->total = 0;
+}
+
+
+/**
+ * @brief Deallocates chain of segments 
+ */
+void seg_chain_dtor(seg_t *seg) {
+    while(seg) {
+        seg_t *tmp = seg;
+        seg = seg->next;
+        free(tmp);
+    }
+}
+
+
+void seg_buff_dtor(seg_buff_t *buff) {
+    seg_chain_dtor(buff->head);
+    seg_chain_dtor(buff->spare);
+    free(buff->flat);
+
+    seg_buff_init(buff);
+}
+
+
+void arena_init(arena_t *arena) {
+    arena->head = NULL;
+}
+
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    const size_t align = _Alignof(max_align_t);
+    size = (size + align - 1) & ~(align - 1); //< Round up to keep the next allocation aligned
+
+    arena_block_t *block = arena->head;
+    if(!block || block->size - block->used < size) { //< There is no space in the current block -> add the new one
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = (arena_block_t *)malloc(sizeof(arena_block_t) + block_size);
+        if(!block) {
+            return NULL;
+        }
+
+        block->size = block_size;
+        block->used = 0;
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void *mem = &(((char *)block->data)[block->used]);
+    block->used += size;
+
+    return mem;
+}
+
+
+char *arena_strndup(arena_t *arena, const char *src, size_t n) {
+    char *dup = (char *)arena_alloc(arena, n + 1);
+    if(dup) {
+        memcpy(dup, src, n);
+        dup[n] = '\0';
+    }
+
+    return dup;
+}
+
+
+void arena_reset(arena_t *arena) {
+    arena_block_t *block = arena->head;
+    if(!block) {
+        return;
+    }
+
+    while(block->next) { //< Only the oldest block is kept
+        arena_block_t *tmp = block;
+        block = block->next;
+        free(tmp);
+    }
+
+    block->used = 0;
+    arena->head = block;
+}
+
+
+void arena_dtor(arena_t *arena) {
+    arena_block_t *block = arena->head;
+    while(block) {
+        arena_block_t *tmp = block;
+        block = block->next;
+        free(tmp);
+    }
+
+    arena->head = NULL;
+}
@@ -13,14 +13,27 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
 
 #include <sys/types.h>
+#include <sys/uio.h>
 
 
 #define INIT_STRING_SIZE 32 //< Default initial size of strings (that are used as buffer)
 #define INIT_NET_BUFF_SIZE 16384 //< Must be big enough for request (at least strlen(req_pattern) + strlen(host) + strlen(path) + strlen("\0"))
+#define SEG_BLOCK_SIZE 16384 //< Capacity of one block of segmented buffer
+#define SEG_MAX_SPARE 4 //< Maximum amount of spare blocks kept by segmented buffer for the next use
+#define ARENA_BLOCK_SIZE 65536 //< Default capacity of one block of arena allocator
+#define INIT_URL_TAB_CAP 64 //< Initial capacity of table with URLs
+#define INIT_URL_CACHE_CAP 64 //< Initial capacity of hash table with results of URLs (must be power of 2)
+#define INIT_HOST_TAB_CAP 16 //< Initial capacity of hash table with hosts (must be power of 2)
+
+#define URL_TAB_NONE ((size_t)-1) //< Index of nonexisting entry of URL table
 
 #define ABS(x) (unsigned int)((x > 0) ? x : -x) //< Returns absolute value of given numeric value
 
@@ -71,24 +84,122 @@ typedef struct string_slice {
 
 
 /**
- * @brief Element of linked list (in this project is used for storing URLs)
+ * @brief One segment (block) of the segmented buffer
+ * 
+ */
+typedef struct seg {
+    struct seg *next; //< Next segment in the chain (or NULL)
+    size_t len; //< Amount of valid bytes in the segment
+    size_t size; //< Capacity of the segment (there is always one extra byte for '\0' behind it)
+    char data[]; //< Content of the segment
+} seg_t;
+
+
+/**
+ * @brief Segmented buffer (chain of fixed size blocks) for data with unknown
+ * length (e. g. HTTP responses), it grows without reallocation and copying
+ * of already stored data
+ * 
+ */
+typedef struct seg_buff {
+    seg_t *head, *tail; //< First and last segment of the chain (or NULL if buffer is empty)
+    seg_t *spare; //< Recycled blocks, that are ready to be used again
+    size_t spare_num; //< Amount of spare blocks (at most SEG_MAX_SPARE are kept after recycling)
+    size_t total; //< Total amount of bytes stored in the buffer
+    char *flat; //< Contiguous copy of the content (created by seg_flatten only if it is necessary)
+    size_t flat_size; //< Capacity of the flat buffer
+} seg_buff_t;
+
+
+/**
+ * @brief Block of memory of arena allocator
+ * 
+ */
+typedef struct arena_block {
+    struct arena_block *next; //< Previous (older) block of the arena
+    size_t used; //< Amount of already allocated bytes of the block
+    size_t size; //< Capacity of the block
+    max_align_t data[]; //< Memory of the block (aligned for any type)
+} arena_block_t;
+
+
+/**
+ * @brief Arena (bump) allocator, all memory allocated by it is released at once
  * 
  */
-typedef struct list_el {
-    string_t *string; //< String structure with content (URL)
-    int indirect_lvl; //< Indirection level (for recognizing redirection URL)
-    int result;
-    struct list_el *next; //< Pointer to next element in the linked list
-} list_el_t;
+typedef struct arena {
+    arena_block_t *head; //< Current block (the newest one)
+} arena_t;
 
 
 /**
- * @brief Linked list structure (for storing URLs)
+ * @brief Table with URLs (columns are stored in parallel arrays and bytes
+ * of all URLs are in one arena)
  * 
  */
-typedef struct list {
-    list_el_t *header; //< Pointer to first element of linked list (or NULL if it is empty)
-} list_t;
+typedef struct url_tab {
+    arena_t strs; //< Arena with content of all URLs
+    char **url; //< URLs (zero terminated strings in strs arena)
+    int *indirect_lvl; //< Indirection level (for recognizing redirection URL)
+    int *result; //< Result code of processing of URL
+    size_t *redir; //< Index of URL, to which the URL was redirected (or URL_TAB_NONE)
+    size_t num; //< Amount of URLs in the table
+    size_t cap; //< Capacity of the columns
+} url_tab_t;
+
+
+/**
+ * @brief Cached result of processing of one (canonical) URL
+ * 
+ */
+typedef struct url_cache_entry {
+    char *key; //< Canonical URL (in arena of the cache) or NULL if slot is empty
+    size_t key_len; //< Length of the key
+    uint64_t hash; //< Hash of the key
+    int result; //< Result code of processing of URL
+    char *redir; //< URL, to which the URL was redirected (in arena of the cache) or NULL
+    char *err_msg; //< The last error message, that was printed for the URL (in arena of the cache) or NULL
+    char *out; //< Output, that was printed for the URL (or NULL)
+    size_t out_len; //< Length of the output
+    int64_t expires; //< Expiration time of the entry in seconds of real time clock (used only by persistent caches)
+} url_cache_entry_t;
+
+
+/**
+ * @brief Hash table (with open addressing) with results of already processed URLs
+ * 
+ */
+typedef struct url_cache {
+    arena_t strs; //< Arena with keys and URLs of redirections
+    url_cache_entry_t *slots; //< Slots of hash table
+    size_t num; //< Amount of used slots
+    size_t cap; //< Capacity of the table (power of 2)
+    size_t out_total; //< Total size of all cached outputs
+} url_cache_t;
+
+
+/**
+ * @brief Slot of the table with hosts
+ */
+typedef struct host_entry {
+    char *host; //< Host (lowercased, in arena of the table) or NULL if slot is empty
+    char *port; //< Port number or service name (in arena of the table)
+    uint64_t hash; //< Hash of host and port
+    void *data; //< Data of the host (in arena of the table, zeroed when the entry is created)
+} host_entry_t;
+
+
+/**
+ * @brief Hash table (with open addressing) with data of hosts (key is the
+ * pair of case insensitive host and port)
+ */
+typedef struct host_tab {
+    arena_t mem; //< Arena with keys and data of entries (they are not moved by extension of the table)
+    host_entry_t *slots; //< Slots of hash table
+    size_t num; //< Amount of used slots
+    size_t cap; //< Capacity of the table (power of 2)
+    size_t data_size; //< Size of data of one host
+} host_tab_t;
 
 
 /**
@@ -154,54 +265,108 @@ bool is_line_empty(char *line_start_ptr);
 
 
 /**
- * @brief Allocates a new element of the linked list (with indirection level 0)
+ * @brief Initializes table with URLs (no memory is allocated)
  * 
- * @param str_content Content of the new element
- * @return list_el_t* Ptr to newly allocated and initialized element or NULL
+ * @param tab Table to be initialized
  */
-list_el_t *new_element(char *str_content);
+void url_tab_init(url_tab_t *tab);
 
 
 /**
- * @brief Creates new element with pointer to given string (there is no 
- * allocation of memory for the new string) 
+ * @brief Frees all resources of given URL table
+ * 
+ * @param tab Table to be freed
  */
-list_el_t *new_element_non_dup(string_t *content);
+void url_tab_dtor(url_tab_t *tab);
 
 
 /**
- * @brief Creates new linked list element from string described in pointed slice
- * 
- * @param slice Slice describing the content of the new element
- * @param indir_level Indirection level of the new element
- * @return list_el_t* Pointer to newly created element or NULL (should be checked)
+ * @brief Removes all URLs from the table, but keeps allocated memory for next URLs
  */
-list_el_t *slice2element(string_slice_t *slice, size_t indir_level);
+void url_tab_reset(url_tab_t *tab);
 
 
 /**
- * @brief Initializes list structure
+ * @brief Adds copy of the URL to the end of table (result is set to SUCCESS
+ * and URL is not redirected)
  * 
- * @param list Struct to be initialized
+ * @param tab Target table
+ * @param url Ptr to the URL (it does not have to be zero terminated)
+ * @param len Length of URL
+ * @param indirect_lvl Indirection level of the new URL
+ * @return size_t Index of the new URL or URL_TAB_NONE if allocation failed
+ */
+size_t url_tab_append(url_tab_t *tab, const char *url, size_t len, int indirect_lvl);
+
+
+/**
+ * @brief Computes FNV-1a hash of the string with given length
+ */
+uint64_t hash_str(const char *str, size_t len);
+
+
+/**
+ * @brief Returns current value of monotonic clock in milliseconds
  */
-void list_init(list_t *list);
+uint64_t mono_ms();
 
 
 /**
- * @brief Frees all resources of given linked list struct
+ * @brief Initializes empty cache with results of URLs
+ */
+void url_cache_init(url_cache_t *cache);
+
+
+/**
+ * @brief Frees all resources of the cache (including cached outputs)
+ */
+void url_cache_dtor(url_cache_t *cache);
+
+
+/**
+ * @brief Finds the result of URL in the cache
  * 
- * @param list List struct to be freed
+ * @param cache Cache with results
+ * @param key Canonical URL
+ * @param len Length of the canonical URL
+ * @return url_cache_entry_t* Entry with result or NULL if URL was not processed yet
  */
-void list_dtor(list_t *list);
+url_cache_entry_t *url_cache_find(url_cache_t *cache, const char *key, size_t len);
 
 
 /**
- * @brief Adds given element to the end of given linked list
+ * @brief Creates new entry in the cache (key must not be present in cache)
  * 
- * @param list List to be extended from the and by given element
- * @param new_element Element to be added to the end of the list
+ * @param cache Cache with results
+ * @param key Canonical URL (it is copied to the cache)
+ * @param len Length of the canonical URL
+ * @return url_cache_entry_t* New entry (with empty result) or NULL if there is not enough memory
  */
-void list_append(list_t *list, list_el_t *new_element);
+url_cache_entry_t *url_cache_insert(url_cache_t *cache, const char *key, size_t len);
+
+
+/**
+ * @brief Initializes empty table with hosts
+ *
+ * @param data_size Size of data, that are kept for each host
+ */
+void host_tab_init(host_tab_t *tab, size_t data_size);
+
+
+/**
+ * @brief Frees all resources of the table (including data of hosts)
+ */
+void host_tab_dtor(host_tab_t *tab);
+
+
+/**
+ * @brief Finds data of the host (or creates zeroed data if create is true)
+ *
+ * @param host Host name or IP address (it is case insensitive)
+ * @param port Port number or service name
+ * @return void* Data of the host or NULL (host is not in the table or there is not enough memory)
+ */
+void *host_tab_get(host_tab_t *tab, const char *host, const char *port, bool create);
 
 
 /**
@@ -327,4 +492,125 @@ string_t *slice2string(string_slice_t *slice);
 void string_dtor(string_t *string);
 
 
+/**
+ * @brief Initializes arena allocator (no memory is allocated) 
+ */
+void arena_init(arena_t *arena);
+
+
+/**
+ * @brief Allocates memory from the arena (memory is aligned for any type,
+ * but it is not initialized)
+ * 
+ * @param arena Arena to be used
+ * @param size Required size of memory
+ * @return void* Ptr to the allocated memory or NULL (should be checked)
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+
+/**
+ * @brief Copies n characters of the given string to the arena
+ * 
+ * @return char* Ptr to the zero terminated copy or NULL (should be checked)
+ */
+char *arena_strndup(arena_t *arena, const char *src, size_t n);
+
+
+/**
+ * @brief Releases all memory allocated from the arena at once (the first block 
+ * is kept for the next use)
+ */
+void arena_reset(arena_t *arena);
+
+
+/**
+ * @brief Deallocates all blocks of the arena
+ */
+void arena_dtor(arena_t *arena);
+
+
+/**
+ * @brief Initializes segmented buffer (no memory is allocated) 
+ */
+void seg_buff_init(seg_buff_t *buff);
+
+
+/**
+ * @brief Prepares vector of free regions at the end of segmented buffer 
+ * (for readv-style reading), the first region is always free space of the
+ * last segment, the following are spare blocks (see seg_commit)
+ * 
+ * @param buff Target buffer
+ * @param iov Output array with free regions 
+ * @param iov_max Maximum amount of regions, that can be stored to iov
+ * @return size_t Amount of prepared regions or 0 if allocation error occured
+ */
+size_t seg_iov(seg_buff_t *buff, struct iovec *iov, size_t iov_max);
+
+
+/**
+ * @brief Marks n bytes in regions prepared by seg_iov as valid content of
+ * the buffer (content is always followed by '\0')
+ * 
+ * @param buff Target buffer
+ * @param n Amount of bytes, that was written to the regions 
+ */
+void seg_commit(seg_buff_t *buff, size_t n);
+
+
+/**
+ * @brief Moves content of the last segment from the given offset to the
+ * separate segment with capacity at least size (so the following content will be
+ * contiguous up to size bytes)
+ * 
+ * @param buff Segmented buffer
+ * @param off Offset of the first byte to be moved (it must be inside the last segment)
+ * @param size Required capacity of the new segment
+ * @return true if realignment was successful
+ * @return false if allocation failed or off is not inside the last segment (buffer is not modified)
+ */
+bool seg_realign(seg_buff_t *buff, size_t off, size_t size);
+
+
+/**
+ * @brief Ensures, that the last segment has at least size bytes of free space
+ * (so the following content will be contiguous up to size bytes), spare block
+ * is used if it is big enough
+ * 
+ * @param buff Segmented buffer
+ * @param size Required free space
+ * @return true if there is enough free space
+ * @return false if allocation failed (buffer is not modified)
+ */
+bool seg_reserve(seg_buff_t *buff, size_t size);
+
+
+/**
+ * @brief Provides contiguous view of the buffer content from the given offset
+ * to the end (content is copied only if it is spread across multiple segments)
+ * 
+ * @param buff Segmented buffer
+ * @param off Offset of the first byte of the view
+ * @param len Output parameter with length of the view 
+ * @return char* Pointer to the start of view (terminated by '\0') or NULL
+ * @warning View is valid only until the next modification of the buffer
+ */
+char *seg_flatten(seg_buff_t *buff, size_t off, size_t *len);
+
+
+/**
+ * @brief Empties the buffer, but keeps up to SEG_MAX_SPARE blocks for the
+ * next use (memory is not erased, oversized segments
+ * and flat copy are freed)
+ */
+void seg_buff_reset(seg_buff_t *buff);
+
+
+/**
+ * @brief Deallocates all resources of segmented buffer
+ */
+void seg_buff_dtor(seg_buff_t *buff);
+
+
 #endif
@@ -0,0 +1,831 @@
+/**
+ * @file conn.c
+ * @brief Src file of module, that establishes connections to servers
+ * (Happy Eyeballs, TLS handshake, deadlines of phases), connects to the
+ * following hosts in advance and keeps latencies of hosts for hedging
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 11. 11. 2022
+ */
+
+#include "conn.h"
+
+
+uint64_t deadline_after(long ms) {
+    return ms > 0 ? mono_ms() + (uint64_t)ms : 0;
+}
+
+
+uint64_t min_deadline(uint64_t a, uint64_t b) {
+    if(!a || !b) {
+        return a ? a : b;
+    }
+
+    return a < b ? a : b;
+}
+
+
+uint64_t nearest_deadline(settings_t *s, uint64_t deadline) {
+    return min_deadline(min_deadline(deadline, s->feed_deadline), s->run_deadline);
+}
+
+
+uint64_t phase_deadline(settings_t *s, int phase) {
+    return nearest_deadline(s, deadline_after(s->timeouts[phase]));
+}
+
+
+int ms_left(uint64_t deadline) {
+    if(!deadline) {
+        return -1;
+    }
+
+    uint64_t now = mono_ms();
+    if(now >= deadline) {
+        return 0;
+    }
+
+    return deadline - now > INT_MAX ? INT_MAX : (int)(deadline - now);
+}
+
+
+/**
+ * @brief Waits until the retried operation of BIO can continue (socket of BIO
+ * must be non-blocking)
+ * 
+ * @return int 1 if BIO is ready, 0 if the deadline passed, -1 in case of error
+ */
+int wait_bio(BIO *bio, uint64_t deadline) {
+    struct pollfd pfd;
+    pfd.fd = BIO_get_fd(bio, NULL);
+    pfd.events = BIO_should_write(bio) ? POLLOUT : POLLIN; //< TLS layer may need to read even if it writes (and vice versa)
+
+    int ret;
+    while((ret = poll(&pfd, 1, ms_left(deadline))) < 0 && errno == EINTR);
+    if(ret <= 0) {
+        return ret;
+    }
+
+    return (pfd.revents & pfd.events) ? 1 : -1;
+}
+
+
+/**
+ * @brief Loads path with certificates due to given settings_t structure
+ * (messages are not printed if quiet is true)
+ */
+int load_verify_paths(SSL_CTX *ctx, settings_t *s, bool quiet) {
+    if(s->certaddr) { //< Check whether folder exists and it is folder (to provide better troubleshooting)
+        struct stat stat_s;
+        memset(&stat_s, 0, sizeof(struct stat));
+
+        if(stat(s->certaddr, &stat_s) || !S_ISDIR(stat_s.st_mode)) {
+            if(!quiet) {
+                printerr(PATH_ERROR, "Zadana cesta '%s' nevede ke slozce!", s->certaddr);
+            }
+
+            return PATH_ERROR;
+        }
+    }
+     
+    int ret = 0;
+    if(!s->certfile && !s->certaddr) {
+        ret = SSL_CTX_set_default_verify_paths(ctx);
+    }
+    else {
+        ret = SSL_CTX_load_verify_locations(ctx, s->certfile, s->certaddr); //< First is performed searching in file then in dir 
+    }
+   
+    if(ret == 0) { //< Setting of paths was not succesful
+        if(!quiet) {
+            const char *appendix = s->certfile || s->certaddr ? "Prosim, zkontrolujte cesty!" : "";
+            printerr(PATH_ERROR, "Nepodarilo se nastavit cesty pro overeni certifikatu! %s", appendix);
+        }
+
+        return PATH_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Orders addresses for connection attempts, families are interleaved
+ * (the first family is the one preferred by getaddrinfo) due to RFC 8305,
+ * address of avoided connection is moved to the end
+ *
+ * @return size_t Amount of addresses in the result
+ */
+size_t order_addrs(struct addrinfo *addrs, struct addrinfo **result, conn_t *avoid) {
+    struct addrinfo *first[MAX_CONN_ADDRS], *second[MAX_CONN_ADDRS];
+    size_t first_n = 0, second_n = 0;
+
+    for(struct addrinfo *cur = addrs; cur; cur = cur->ai_next) {
+        if(cur->ai_family == addrs->ai_family) {
+            if(first_n < MAX_CONN_ADDRS) {
+                first[first_n++] = cur;
+            }
+        }
+        else if(second_n < MAX_CONN_ADDRS) {
+            second[second_n++] = cur;
+        }
+    }
+
+    size_t n = 0;
+    for(size_t i = 0; n < MAX_CONN_ADDRS && (i < first_n || i < second_n); i++) {
+        if(i < first_n) {
+            result[n++] = first[i];
+        }
+
+        if(i < second_n && n < MAX_CONN_ADDRS) {
+            result[n++] = second[i];
+        }
+    }
+
+    for(size_t i = 0; avoid && avoid->peer_len && i + 1 < n; i++) {
+        if(result[i]->ai_addrlen == avoid->peer_len && !memcmp(result[i]->ai_addr, &(avoid->peer), avoid->peer_len)) {
+            struct addrinfo *avoided = result[i];
+            memmove(&(result[i]), &(result[i + 1]), (n - i - 1)*sizeof(struct addrinfo *));
+            result[n - 1] = avoided;
+            break;
+        }
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Starts non-blocking connection attempt to the address
+ *
+ * @return int Socket with connection in progress (or already connected) or -1
+ */
+int start_attempt(struct addrinfo *addr, bool *connected) {
+    int fd = socket(addr->ai_family, addr->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, addr->ai_protocol);
+    if(fd < 0) {
+        return -1;
+    }
+
+    int ret;
+    while((ret = connect(fd, addr->ai_addr, addr->ai_addrlen)) < 0 && errno == EINTR);
+    if(ret < 0 && errno != EINPROGRESS) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    *connected = (ret == 0);
+
+    return fd;
+}
+
+
+/**
+ * @brief Closes all pending connection attempts except the winning one
+ */
+void close_attempts(struct pollfd *pfds, size_t n, int winner) {
+    for(size_t i = 0; i < n; i++) {
+        if(pfds[i].fd != winner) {
+            close(pfds[i].fd);
+        }
+    }
+}
+
+
+/**
+ * @brief Opens TCP connection to the host, addresses are taken from the 
+ * resolver (so they are usually already resolved in advance), attempts to
+ * them are raced due to Happy Eyeballs (RFC 8305) - next attempt starts when
+ * the previous one fails or does not succeed within CONN_ATTEMPT_DELAY_MS, 
+ * the first established connection wins, resolution and all attempts are
+ * limited by their timeouts
+ * 
+ * @return int Connected non-blocking socket or -1 if connection cannot be
+ * established (its reason is stored to fail of conn)
+ */
+int open_socket(conn_t *conn, resolver_t *resolver, char *host, char *port, settings_t *s, conn_t *avoid) {
+    int err;
+    errno = 0;
+    struct addrinfo *addrs = resolver_get(resolver, host, port, ms_left(phase_deadline(s, TO_DNS)), &err);
+
+    struct addrinfo *cands[MAX_CONN_ADDRS];
+    size_t cand_n = order_addrs(addrs, cands, avoid), next = 0;
+
+    struct pollfd pfds[MAX_CONN_ADDRS];
+    uint64_t started[MAX_CONN_ADDRS]; //< Start times of pending attempts
+    size_t pending = 0;
+
+    int winner = -1;
+    uint64_t deadline = phase_deadline(s, TO_CONNECT); //< Deadline of all attempts
+    uint64_t now = mono_ms(), next_start = now;
+    while(winner < 0 && (next < cand_n || pending)) {
+        if(deadline && now >= deadline) {
+            errno = ETIMEDOUT;
+            break;
+        }
+
+        if(next < cand_n && (!pending || now >= next_start)) { //< Start the next attempt
+            bool connected = false;
+            int fd = start_attempt(cands[next++], &connected);
+            if(fd >= 0) {
+                pfds[pending].fd = fd;
+                pfds[pending].events = POLLOUT;
+                started[pending++] = now;
+
+                winner = connected ? fd : -1;
+            }
+
+            next_start = now + CONN_ATTEMPT_DELAY_MS;
+            continue;
+        }
+
+        uint64_t wake = next < cand_n ? next_start : UINT64_MAX; //< Compute time of the nearest event
+        for(size_t i = 0; i < pending; i++) {
+            if(started[i] + CONN_TIMEOUT_MS < wake) {
+                wake = started[i] + CONN_TIMEOUT_MS;
+            }
+        }
+
+        if(deadline && deadline < wake) {
+            wake = deadline;
+        }
+
+        int ret = poll(pfds, pending, wake > now ? (int)(wake - now) : 0);
+        if(ret < 0 && errno != EINTR) {
+            break;
+        }
+
+        now = mono_ms();
+        for(size_t i = pending; i-- > 0; ) { //< Backwards, because finished attempts are removed
+            bool failed = false;
+            if(ret > 0 && pfds[i].revents) {
+                int so_err = 0;
+                socklen_t so_len = sizeof(so_err);
+                if(getsockopt(pfds[i].fd, SOL_SOCKET, SO_ERROR, &so_err, &so_len) < 0) {
+                    so_err = errno;
+                }
+
+                if(!so_err) {
+                    winner = pfds[i].fd;
+                    break;
+                }
+
+                errno = so_err;
+                failed = true;
+            }
+            else if(now >= started[i] + CONN_TIMEOUT_MS) {
+                errno = ETIMEDOUT;
+                failed = true;
+            }
+
+            if(failed) { //< Remove attempt and start the next one immediately
+                close(pfds[i].fd);
+                pfds[i] = pfds[--pending];
+                started[i] = started[pending];
+                next_start = now;
+            }
+        }
+    }
+
+    int conn_errno = errno;
+    close_attempts(pfds, pending, winner);
+    bool is_resolved = addrs != NULL;
+    free(addrs); //< Candidates point to the copy of addresses
+    if(winner >= 0) {
+        return winner;
+    }
+
+    if(!is_resolved) { //< Resolution failed (or it did not finish in time)
+        conn->fail = conn_errno == ETIMEDOUT ? CONN_FAIL_TIMEOUT : CONN_FAIL_UNRESOLVED;
+    }
+    else {
+        conn->fail = conn_errno == ETIMEDOUT ? CONN_FAIL_TIMEOUT : CONN_FAIL_REFUSED;
+    }
+
+    errno = conn_errno;
+
+    #ifdef DEBUG
+        fprintf(stderr, "Connection to %s:%s failed (%s)\n", host, port, err ? gai_strerror(err) : strerror(errno));
+    #endif
+
+    return -1;
+}
+
+
+/**
+ * @brief Performs TLS handshake over non-blocking socket (limited by timeout)
+ * 
+ * @return int 1 if handshake was successful, 0 if the deadline passed, -1 in case of error
+ */
+int do_handshake(BIO *bio, settings_t *s) {
+    uint64_t deadline = phase_deadline(s, TO_TLS);
+
+    int ret;
+    while(BIO_do_handshake(bio) <= 0) {
+        if(!BIO_should_retry(bio)) {
+            return -1;
+        }
+        else if((ret = wait_bio(bio, deadline)) <= 0) {
+            return ret;
+        }
+    }
+
+    return 1;
+}
+
+
+void conn_init(conn_t *conn) {
+    conn->bio = NULL;
+    conn->ctx = NULL;
+    conn->fail = CONN_FAIL_NONE;
+    conn->peer_len = 0;
+}
+
+
+int conn_open(conn_t *conn, bool tls, char *host, char *port, settings_t *s, resolver_t *resolver, bool quiet, conn_t *avoid) {
+    int ret;
+    SSL *ssl = NULL;
+
+    if(tls) {
+        //Based on IBM tutorial https://developer.ibm.com/tutorials/l-openssl/
+        conn->ctx = SSL_CTX_new(SSLv23_client_method());
+
+        if((ret = load_verify_paths(conn->ctx, s, quiet)) != SUCCESS) {
+            return ret;
+        }
+
+        conn->bio = BIO_new_ssl(conn->ctx, 1); //< TLS layer in client mode (socket BIO is pushed under it after connecting)
+        BIO_get_ssl(conn->bio, &ssl);
+        if(!ssl) {
+            if(!quiet) {
+                printerr(INTERNAL_ERROR, "Chyba pri alokaci SSL struktury!");
+            }
+
+            return INTERNAL_ERROR;
+        }
+
+        SSL_set_mode(ssl, SSL_MODE_AUTO_RETRY); //< Set ssl to auto retry to prevent errors caused by non-application data
+        //End of code based on https://developer.ibm.com/tutorials/l-openssl/
+
+        if(!SSL_set_tlsext_host_name(ssl, host)) { //< Set Server Name Indication (if it is missing, self signed certificate error can occur)
+            if(!quiet) {
+                printerr(INTERNAL_ERROR, "Chyba pri nastavovani SNI!");
+            }
+
+            return INTERNAL_ERROR;
+        }
+    }
+
+    int fd = open_socket(conn, resolver, host, port, s, avoid);
+    if(fd < 0) {
+        return CONNECTION_ERROR;
+    }
+
+    conn->peer_len = sizeof(conn->peer);
+    if(getpeername(fd, (struct sockaddr *)&(conn->peer), &(conn->peer_len))) { //< Address is used only as a hint for hedged requests
+        conn->peer_len = 0;
+    }
+
+    BIO *sock_bio = BIO_new_socket(fd, BIO_CLOSE);
+    if(!sock_bio) {
+        if(!quiet) {
+            printerr(INTERNAL_ERROR, "Chyba pri alokaci BIO struktury!");
+        }
+
+        close(fd);
+        return INTERNAL_ERROR;
+    }
+
+    if(!tls) {
+        conn->bio = sock_bio;
+        return SUCCESS;
+    }
+
+    BIO_push(conn->bio, sock_bio); //< From now socket is freed together with TLS layer
+
+    if((ret = do_handshake(conn->bio, s)) <= 0) {
+        conn->fail = ret == 0 ? CONN_FAIL_TLS_TIMEOUT : CONN_FAIL_REFUSED;
+        return CONNECTION_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+void conn_print_fail(conn_t *conn, const char *url) {
+    if(conn->fail == CONN_FAIL_TIMEOUT) {
+        printerr(CONNECTION_ERROR, "Vyprsel cas pro spojeni s '%s'!", url);
+    }
+    else if(conn->fail == CONN_FAIL_TLS_TIMEOUT) {
+        printerr(CONNECTION_ERROR, "Vyprsel cas pro navazani TLS spojeni s '%s'!", url);
+    }
+    else {
+        printerr(CONNECTION_ERROR, "Nelze se spojit s '%s'!", url);
+    }
+}
+
+
+void conn_close(conn_t *conn) {
+    if(conn->bio) {
+        BIO_free_all(conn->bio);
+    }
+
+    if(conn->ctx) {
+        SSL_CTX_free(conn->ctx);
+    }
+
+    conn_init(conn);
+}
+
+
+bool conn_responding(conn_t *conn) {
+    char c;
+    SSL *ssl = NULL;
+    BIO_get_ssl(conn->bio, &ssl);
+    if(!ssl) {
+        ssize_t ret = recv(BIO_get_fd(conn->bio, NULL), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        return ret >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+    }
+
+    ERR_clear_error();
+    int ret = SSL_peek(ssl, &c, 1); //< Processes incoming TLS records (but application data stay in the buffer)
+    if(ret > 0) {
+        return true;
+    }
+
+    int err = SSL_get_error(ssl, ret);
+    return err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE;
+}
+
+
+/**
+ * @brief Checks whether the idle connection (established in advance or kept
+ * after response) was not closed by the server in the meantime (pending data, e. g. TLS session tickets,
+ * are not consumed)
+ */
+bool conn_alive(conn_t *conn) {
+    char c;
+    ssize_t ret = recv(BIO_get_fd(conn->bio, NULL), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+
+    return ret > 0 || (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+}
+
+
+/**
+ * @brief Returns slot with connection to the host (or NULL), lock must be held by the caller
+ */
+preconn_slot_t *preconn_find(preconn_t *preconn, bool tls, const char *host, const char *port) {
+    for(size_t i = 0; i < PRECONN_NUM; i++) {
+        preconn_slot_t *slot = &(preconn->slots[i]);
+        if(slot->state != PRECONN_EMPTY && slot->tls == tls && 
+           !strcasecmp(slot->host, host) && !strcmp(slot->port, port)) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Returns free slot (too old connections are closed to free their slots), 
+ * lock must be held by the caller
+ */
+preconn_slot_t *preconn_free_slot(preconn_t *preconn) {
+    uint64_t now = mono_ms();
+    for(size_t i = 0; i < PRECONN_NUM; i++) {
+        preconn_slot_t *slot = &(preconn->slots[i]);
+        if(slot->state == PRECONN_READY && now - slot->ready_at > PRECONN_MAX_IDLE_MS) { //< Connection was not used (e. g. source was taken from cache)
+            conn_close(&(slot->conn));
+            slot->state = PRECONN_EMPTY;
+        }
+
+        if(slot->state == PRECONN_EMPTY) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Worker, that connects to requested hosts until the pre-connector is stopped
+ */
+void *preconn_worker(void *arg) {
+    preconn_t *preconn = (preconn_t *)arg;
+
+    pthread_mutex_lock(&(preconn->lock));
+    while(true) {
+        preconn_slot_t *slot = NULL;
+        while(!preconn->stop) {
+            for(size_t i = 0; i < PRECONN_NUM && !slot; i++) {
+                slot = preconn->slots[i].state == PRECONN_QUEUED ? &(preconn->slots[i]) : NULL;
+            }
+
+            if(slot) {
+                break;
+            }
+
+            pthread_cond_wait(&(preconn->job_cond), &(preconn->lock));
+        }
+
+        if(preconn->stop) {
+            break;
+        }
+
+        slot->state = PRECONN_CONNECTING;
+        pthread_mutex_unlock(&(preconn->lock));
+
+        conn_t conn; //< Host, port and avoided address of slot are not modified during connecting
+        conn_init(&conn);
+        int result = conn_open(&conn, slot->tls, slot->host, slot->port, &(preconn->settings), preconn->resolver, true, &(slot->avoid));
+
+        pthread_mutex_lock(&(preconn->lock));
+        slot->conn = conn;
+        slot->result = result;
+        slot->ready_at = mono_ms();
+        slot->state = PRECONN_READY;
+        pthread_cond_broadcast(&(preconn->done_cond));
+    }
+    pthread_mutex_unlock(&(preconn->lock));
+
+    return NULL;
+}
+
+
+int preconn_init(preconn_t *preconn, settings_t *settings, resolver_t *resolver) {
+    memset(preconn, 0, sizeof(preconn_t));
+
+    if(pthread_mutex_init(&(preconn->lock), NULL) ||
+       pthread_cond_init(&(preconn->job_cond), NULL) ||
+       pthread_cond_init(&(preconn->done_cond), NULL)) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se inicializovat synchronizaci pro spojeni predem!");
+        return INTERNAL_ERROR;
+    }
+
+    preconn->settings = *settings;
+    preconn->settings.feed_deadline = 0;
+    preconn->resolver = resolver;
+    preconn->ready = true;
+
+    return SUCCESS;
+}
+
+
+bool preconn_request(preconn_t *preconn, bool tls, const char *host, const char *port, conn_t *avoid) {
+    if(!preconn->ready || strlen(host) > MAX_HOST_LEN || strlen(port) > MAX_PORT_LEN) {
+        return false;
+    }
+
+    pthread_mutex_lock(&(preconn->lock));
+
+    if(!preconn->started) { //< Workers are started lazily (they are not needed, if there is only one URL)
+        preconn->started = true;
+        for(; preconn->worker_num < PRECONN_NUM; preconn->worker_num++) {
+            if(pthread_create(&(preconn->workers[preconn->worker_num]), NULL, preconn_worker, preconn)) {
+                break;
+            }
+        }
+    }
+
+    bool is_prepared = preconn_find(preconn, tls, host, port) != NULL;
+    preconn_slot_t *slot = is_prepared || !preconn->worker_num ? NULL : preconn_free_slot(preconn);
+    if(slot) {
+        strcpy(slot->host, host);
+        strcpy(slot->port, port);
+        slot->tls = tls;
+        conn_init(&(slot->avoid));
+        if(avoid) {
+            slot->avoid.peer = avoid->peer;
+            slot->avoid.peer_len = avoid->peer_len;
+        }
+
+        slot->state = PRECONN_QUEUED;
+        pthread_cond_signal(&(preconn->job_cond));
+    }
+
+    pthread_mutex_unlock(&(preconn->lock));
+
+    return is_prepared || slot;
+}
+
+
+/**
+ * @brief Takes connection to the host established in advance (see preconn_take
+ * and preconn_try_take)
+ *
+ * @param wait If it is true, it waits until connecting is finished
+ * @return int 1 if connection was taken, 0 if connecting is not finished yet,
+ * -1 if there is no usable connection
+ */
+int preconn_take_conn(preconn_t *preconn, bool tls, const char *host, const char *port, conn_t *conn, int *result, bool wait) {
+    if(!preconn->ready) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&(preconn->lock));
+
+    preconn_slot_t *slot = preconn_find(preconn, tls, host, port);
+    if(!slot) {
+        pthread_mutex_unlock(&(preconn->lock));
+        return -1;
+    }
+
+    while(slot->state != PRECONN_READY) { //< Connecting is not finished yet (queued slot is taken by the next free worker)
+        if(!wait) {
+            pthread_mutex_unlock(&(preconn->lock));
+            return 0;
+        }
+
+        pthread_cond_wait(&(preconn->done_cond), &(preconn->lock));
+    }
+
+    *conn = slot->conn;
+    *result = slot->result;
+    uint64_t age = mono_ms() - slot->ready_at;
+    conn_init(&(slot->conn));
+    slot->state = PRECONN_EMPTY;
+
+    pthread_mutex_unlock(&(preconn->lock));
+
+    bool is_usable = *result == CONNECTION_ERROR || //< Failure is reported as it would be if it occured now
+                     (*result == SUCCESS && age <= PRECONN_MAX_IDLE_MS && conn_alive(conn));
+    if(!is_usable) { //< E. g. error of paths with certificates, it must be reported by new connecting
+        conn_close(conn);
+    }
+
+    return is_usable ? 1 : -1;
+}
+
+
+bool preconn_take(preconn_t *preconn, bool tls, const char *host, const char *port, conn_t *conn, int *result) {
+    return preconn_take_conn(preconn, tls, host, port, conn, result, true) == 1;
+}
+
+
+int preconn_try_take(preconn_t *preconn, bool tls, const char *host, const char *port, conn_t *conn, int *result) {
+    return preconn_take_conn(preconn, tls, host, port, conn, result, false);
+}
+
+
+void preconn_dtor(preconn_t *preconn) {
+    if(!preconn->ready) {
+        return;
+    }
+
+    pthread_mutex_lock(&(preconn->lock));
+    preconn->stop = true;
+    pthread_cond_broadcast(&(preconn->job_cond));
+    pthread_mutex_unlock(&(preconn->lock));
+
+    for(size_t i = 0; i < preconn->worker_num; i++) {
+        pthread_join(preconn->workers[i], NULL);
+    }
+
+    for(size_t i = 0; i < PRECONN_NUM; i++) {
+        conn_close(&(preconn->slots[i].conn));
+    }
+
+    pthread_mutex_destroy(&(preconn->lock));
+    pthread_cond_destroy(&(preconn->job_cond));
+    pthread_cond_destroy(&(preconn->done_cond));
+
+    memset(preconn, 0, sizeof(preconn_t));
+}
+
+
+/**
+ * @brief Computes percentile of latencies in the entry (HEDGE_PERCENTILE)
+ */
+uint64_t latency_percentile(latency_entry_t *entry) {
+    uint32_t sorted[HEDGE_MAX_SAMPLES];
+    memcpy(sorted, entry->samples, entry->num*sizeof(uint32_t));
+
+    for(size_t i = 1; i < entry->num; i++) { //< Insertion sort (there are only few samples)
+        uint32_t cur = sorted[i];
+        size_t j = i;
+        for(; j > 0 && sorted[j - 1] > cur; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+
+        sorted[j] = cur;
+    }
+
+    size_t rank = (entry->num*HEDGE_PERCENTILE + 99)/100; //< Nearest-rank method
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+
+/**
+ * @brief Adds latency to the ring buffer of the entry
+ */
+void latency_add(latency_entry_t *entry, uint64_t latency) {
+    entry->samples[entry->next] = latency > UINT32_MAX ? UINT32_MAX : (uint32_t)latency;
+    entry->next = (entry->next + 1) % HEDGE_MAX_SAMPLES;
+    if(entry->num < HEDGE_MAX_SAMPLES) {
+        entry->num++;
+    }
+}
+
+
+uint64_t hedge_delay(hedge_t *hedge, const char *host, const char *port) {
+    latency_entry_t *entry = (latency_entry_t *)host_tab_get(&(hedge->tab), host, port, false);
+
+    if(!entry || entry->num < HEDGE_MIN_SAMPLES) { //< Latencies of all hosts are used instead
+        entry = &(hedge->all);
+    }
+
+    if(entry->num < HEDGE_MIN_SAMPLES) {
+        return 0;
+    }
+
+    uint64_t delay = latency_percentile(entry);
+    return delay < HEDGE_MIN_DELAY_MS ? HEDGE_MIN_DELAY_MS : delay;
+}
+
+
+void hedge_record(hedge_t *hedge, const char *host, const char *port, uint64_t latency) {
+    latency_add(&(hedge->all), latency);
+
+    latency_entry_t *entry = (latency_entry_t *)host_tab_get(&(hedge->tab), host, port, true);
+    if(entry) {
+        latency_add(entry, latency);
+    }
+}
+
+
+void conn_keep(net_t *net, conn_t *conn, bool tls, const char *host, const char *port) {
+    kept_conn_t *kept = &(net->kept);
+    conn_close(&(kept->conn));
+
+    if(strlen(host) > MAX_HOST_LEN || strlen(port) > MAX_PORT_LEN) {
+        conn_close(conn);
+        return;
+    }
+
+    strcpy(kept->host, host);
+    strcpy(kept->port, port);
+    kept->tls = tls;
+    kept->kept_at = mono_ms();
+    kept->conn = *conn;
+
+    conn_init(conn);
+}
+
+
+bool conn_take_kept(net_t *net, bool tls, const char *host, const char *port, conn_t *conn) {
+    kept_conn_t *kept = &(net->kept);
+    if(!kept->conn.bio) {
+        return false;
+    }
+
+    bool is_usable = kept->tls == tls && !strcasecmp(kept->host, host) && !strcmp(kept->port, port) &&
+                     mono_ms() - kept->kept_at <= KEPT_CONN_MAX_IDLE_MS && conn_alive(&(kept->conn));
+    if(!is_usable) { //< Only one connection is kept, so it would not be used anymore
+        conn_close(&(kept->conn));
+        return false;
+    }
+
+    *conn = kept->conn;
+    conn_init(&(kept->conn));
+
+    return true;
+}
+
+
+int net_init(net_t *net, settings_t *settings) {
+    memset(&(net->hedge), 0, sizeof(hedge_t));
+    host_tab_init(&(net->hedge.tab), sizeof(latency_entry_t));
+    net->preconn.ready = false;
+    net->resolver.shared = NULL;
+    net->last_fail = CONN_FAIL_NONE;
+    breaker_init(&(net->breaker), settings->state_file);
+    conn_init(&(net->kept.conn));
+
+    int ret = limiter_init(&(net->limiter), settings);
+    if(ret != SUCCESS) {
+        return ret;
+    }
+
+    if((ret = resolver_init(&(net->resolver))) != SUCCESS) {
+        return ret;
+    }
+
+    return preconn_init(&(net->preconn), settings, &(net->resolver));
+}
+
+
+void net_dtor(net_t *net) {
+    conn_close(&(net->kept.conn));
+    preconn_dtor(&(net->preconn)); //< Workers of pre-connector use resolver
+    resolver_dtor(&(net->resolver));
+
+    host_tab_dtor(&(net->hedge.tab));
+    memset(&(net->hedge), 0, sizeof(hedge_t));
+
+    breaker_save(&(net->breaker)); //< Failure is only reported (results of sources were already printed)
+    breaker_dtor(&(net->breaker));
+    limiter_dtor(&(net->limiter));
+}
@@ -0,0 +1,355 @@
+/**
+ * @file conn.h
+ * @brief Header file of module, that establishes connections to servers
+ * (Happy Eyeballs, TLS handshake, deadlines of phases), connects to the
+ * following hosts in advance and keeps latencies of hosts for hedging
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 11. 11. 2022
+ */
+
+#ifndef _FEEDREADER_CONN_
+#define _FEEDREADER_CONN_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "common.h"
+#include "cli.h"
+#include "dns.h"
+#include "breaker.h"
+#include "limit.h"
+
+
+#define CONN_TIMEOUT_MS 3000 //< Maximum time in ms of one connection attempt (to one address)
+#define CONN_ATTEMPT_DELAY_MS 250 //< Delay between starts of concurrent connection attempts (Happy Eyeballs, RFC 8305)
+#define MAX_CONN_ADDRS 16 //< Maximum amount of addresses of one host, that are tried
+
+#define PRECONN_NUM 4 //< Maximum amount of hosts, that are connected in advance (and amount of threads, that connect them)
+#define PRECONN_MAX_IDLE_MS 5000 //< Connections established in advance, that are older, are not used (server may close them)
+
+#define KEPT_CONN_MAX_IDLE_MS 2000 //< Connection kept open after redirection is not reused after this time
+
+#define HEDGE_PERCENTILE 90 //< Percentile of latencies of the host, after which the hedged request is sent
+#define HEDGE_MIN_SAMPLES 4 //< Minimal amount of latencies needed for computing of percentile
+#define HEDGE_MAX_SAMPLES 32 //< Amount of the last latencies kept for each host
+#define HEDGE_MIN_DELAY_MS 50 //< Minimal delay of hedged request (requests to fast hosts are not doubled)
+#define HEDGE_CONN_CHECK_MS 10 //< Interval of checks, whether connection for hedged request is established
+
+
+/**
+ * @brief Reasons of failed connection (they select the message printed by conn_print_fail)
+ */
+enum conn_fails {
+    CONN_FAIL_NONE,
+    CONN_FAIL_REFUSED, //< Server is not reachable or TLS handshake failed
+    CONN_FAIL_UNRESOLVED, //< Host cannot be resolved (failed resolution is cached, so it is not worth repeating)
+    CONN_FAIL_TIMEOUT, //< TCP connection was not established in time
+    CONN_FAIL_TLS_TIMEOUT, //< TLS handshake was not finished in time
+};
+
+
+/**
+ * @brief Connection to the server
+ */
+typedef struct conn {
+    BIO *bio; //< Chain of BIOs (TLS layer on the top of socket for HTTPS) or NULL
+    SSL_CTX *ctx; //< TLS context (NULL for HTTP)
+    int fail; //< Reason of failure if connection failed (see conn_fails)
+    struct sockaddr_storage peer; //< Address of the server
+    socklen_t peer_len; //< Length of the address of the server (0 if it is unknown)
+} conn_t;
+
+
+/**
+ * @brief States of slot for connection established in advance
+ */
+enum preconn_states {
+    PRECONN_EMPTY,
+    PRECONN_QUEUED, //< Connection was requested, but nobody works on it yet
+    PRECONN_CONNECTING,
+    PRECONN_READY, //< Connecting finished (successfully or not)
+};
+
+
+/**
+ * @brief Connection to one host established in advance
+ */
+typedef struct preconn_slot {
+    char host[MAX_HOST_LEN + 1]; //< Host and port in the same form as they are in URL
+    char port[MAX_PORT_LEN + 1];
+    bool tls; //< Flag signalizing, that TLS handshake should be performed
+    int state; //< Value from preconn_states
+    int result; //< Result of connecting (valid in READY state)
+    uint64_t ready_at; //< Time (in ms of monotonic clock), when connecting finished
+    conn_t conn; //< Established connection
+    conn_t avoid; //< Only address of connection, whose address should be tried as the last one (peer_len is 0 if there is no such connection)
+} preconn_slot_t;
+
+
+/**
+ * @brief Pre-connector, that connects to hosts of following URLs by its
+ * workers, while the current URL is processed
+ * @note Only one thread may request and take connections
+ */
+typedef struct preconn {
+    preconn_slot_t slots[PRECONN_NUM];
+    pthread_t workers[PRECONN_NUM]; //< Threads, that connect requested hosts (they are started by the first request)
+    size_t worker_num; //< Amount of running workers
+    settings_t settings; //< Copy of settings (deadline of the current source does not limit connecting in advance)
+    resolver_t *resolver; //< Shared resolver
+    pthread_mutex_t lock; //< Lock for slots
+    pthread_cond_t job_cond; //< Signalizes new request (or stopping of pre-connector)
+    pthread_cond_t done_cond; //< Signalizes finished connecting
+    bool started; //< Flag signalizing, that starting of workers was already tried
+    bool stop; //< Flag signalizing, that workers should end
+    bool ready; //< Flag signalizing, that pre-connector was succesfully initialized
+} preconn_t;
+
+
+/**
+ * @brief Connection, that was kept open after response (for the next request to the same origin)
+ */
+typedef struct kept_conn {
+    char host[MAX_HOST_LEN + 1]; //< Host and port in the same form as they are in URL
+    char port[MAX_PORT_LEN + 1];
+    bool tls; //< Flag signalizing, that TLS layer is used
+    uint64_t kept_at; //< Time (in ms of monotonic clock), when the response was received
+    conn_t conn; //< Connection (bio is NULL if there is no kept connection)
+} kept_conn_t;
+
+
+/**
+ * @brief The last latencies (time to the first byte of response) of one host
+ */
+typedef struct latency_entry {
+    uint32_t samples[HEDGE_MAX_SAMPLES]; //< Ring buffer with latencies in ms
+    size_t num; //< Amount of valid samples
+    size_t next; //< Index for the next sample
+} latency_entry_t;
+
+
+/**
+ * @brief Latencies of hosts and statistics of hedged requests
+ */
+typedef struct hedge {
+    host_tab_t tab; //< Table with latencies of hosts (latency_entry_t)
+    latency_entry_t all; //< Latencies of all hosts (used for hosts without enough samples)
+    size_t sent; //< Amount of sent hedged requests
+    size_t won; //< Amount of hedged requests, that were faster than original requests
+    uint64_t saved_ms; //< Lower estimate of saved time
+} hedge_t;
+
+
+/**
+ * @brief Network resources shared by all requests of one reader
+ */
+typedef struct net {
+    resolver_t resolver; //< Resolver with cache of addresses of hosts
+    preconn_t preconn; //< Connections to hosts of following URLs established in advance
+    hedge_t hedge; //< Latencies of hosts for hedged requests
+    breaker_t breaker; //< Failures of hosts (circuit breaker)
+    kept_conn_t kept; //< Connection kept open after redirection
+    limiter_t limiter; //< Limiter of rates of requests and transferred bytes
+    int last_fail; //< Reason of the last reported connection failure (see conn_fails)
+} net_t;
+
+
+/**
+ * @brief Returns deadline, that is given ms from now (0 ms means no deadline)
+ * @note Deadlines are in ms of monotonic clock (see mono_ms), 0 means no deadline
+ */
+uint64_t deadline_after(long ms);
+
+
+/**
+ * @brief Returns the earlier of two deadlines
+ */
+uint64_t min_deadline(uint64_t a, uint64_t b);
+
+
+/**
+ * @brief Returns the earliest of given deadline and deadlines of the current
+ * source and the whole run
+ */
+uint64_t nearest_deadline(settings_t *s, uint64_t deadline);
+
+
+/**
+ * @brief Computes deadline of the phase (value from timeouts enum), that starts now
+ */
+uint64_t phase_deadline(settings_t *s, int phase);
+
+
+/**
+ * @brief Returns time in ms, that remains to the deadline (-1 if there is no deadline)
+ */
+int ms_left(uint64_t deadline);
+
+
+/**
+ * @brief Waits until the retried operation of BIO can continue (socket of BIO
+ * must be non-blocking)
+ *
+ * @return int 1 if BIO is ready, 0 if the deadline passed, -1 in case of error
+ */
+int wait_bio(BIO *bio, uint64_t deadline);
+
+
+/**
+ * @brief Initializes empty connection
+ */
+void conn_init(conn_t *conn);
+
+
+/**
+ * @brief Establishes connection to the server (connected socket is non-blocking)
+ *
+ * @param conn Initialized connection
+ * @param tls If it is true, TLS handshake is performed (certificate is not checked yet)
+ * @param host Host name or IP address
+ * @param port Port number
+ * @param s Settings with timeouts and paths with certificates
+ * @param resolver Resolver
+ * @param quiet If it is true, no messages are printed (for connecting in background)
+ * @param avoid Connection, whose address should be tried as the last one (or NULL)
+ * @return int SUCCESS, CONNECTION_ERROR (its reason is in fail, see
+ * conn_print_fail) or other error code (e. g. PATH_ERROR)
+ */
+int conn_open(conn_t *conn, bool tls, char *host, char *port, settings_t *s, resolver_t *resolver, bool quiet, conn_t *avoid);
+
+
+/**
+ * @brief Checks without blocking whether the server started to respond
+ * (TLS records without application data, e. g. session tickets, are not
+ * considered as response)
+ *
+ * @return true if there are data to be read (or the connection was closed or failed)
+ */
+bool conn_responding(conn_t *conn);
+
+
+/**
+ * @brief Prints message about failed connection (CONNECTION_ERROR returned by conn_open) with given URL
+ */
+void conn_print_fail(conn_t *conn, const char *url);
+
+
+/**
+ * @brief Closes the connection and frees its resources
+ */
+void conn_close(conn_t *conn);
+
+
+/**
+ * @brief Initializes pre-connector (workers are started by the first request)
+ *
+ * @return int SUCCESS or INTERNAL_ERROR
+ */
+int preconn_init(preconn_t *preconn, settings_t *settings, resolver_t *resolver);
+
+
+/**
+ * @brief Requests connection to the host in advance (if there is no connection
+ * to it yet)
+ *
+ * @param avoid Connection, whose address should be tried as the last one (or NULL)
+ * @return true if connection to the host is (or will be) prepared, false if
+ * there is no free slot
+ */
+bool preconn_request(preconn_t *preconn, bool tls, const char *host, const char *port, conn_t *avoid);
+
+
+/**
+ * @brief Takes connection to the host established in advance (it waits if
+ * connecting is not finished yet)
+ *
+ * @param conn Output parameter for the connection
+ * @param result Output parameter for the result of connecting (SUCCESS or CONNECTION_ERROR)
+ * @return true if connection was taken, false if there is no usable connection
+ * (e. g. it is too old or closed by server) and it must be established again
+ */
+bool preconn_take(preconn_t *preconn, bool tls, const char *host, const char *port, conn_t *conn, int *result);
+
+
+/**
+ * @brief Takes connection to the host established in advance without waiting
+ * (see preconn_take)
+ *
+ * @return int 1 if connection was taken, 0 if connecting is not finished yet,
+ * -1 if there is no usable connection
+ */
+int preconn_try_take(preconn_t *preconn, bool tls, const char *host, const char *port, conn_t *conn, int *result);
+
+
+/**
+ * @brief Stops workers and closes all unused connections
+ */
+void preconn_dtor(preconn_t *preconn);
+
+
+/**
+ * @brief Returns delay, after which the hedged request to the host should be
+ * sent (percentile of its latencies)
+ *
+ * @return uint64_t Delay in ms or 0 if there are not enough latencies yet
+ */
+uint64_t hedge_delay(hedge_t *hedge, const char *host, const char *port);
+
+
+/**
+ * @brief Stores latency of the host
+ */
+void hedge_record(hedge_t *hedge, const char *host, const char *port, uint64_t latency);
+
+
+/**
+ * @brief Keeps the connection open for the next request to the same origin
+ * (previously kept connection is closed), the connection is moved to net
+ */
+void conn_keep(net_t *net, conn_t *conn, bool tls, const char *host, const char *port);
+
+
+/**
+ * @brief Takes the kept connection to the given origin (it is closed if it is
+ * for other origin, too old or closed by server)
+ *
+ * @return true if connection was taken
+ */
+bool conn_take_kept(net_t *net, bool tls, const char *host, const char *port, conn_t *conn);
+
+
+/**
+ * @brief Initializes network resources of reader (state of circuit breaker is
+ * loaded, shared state of limiter is mapped)
+ *
+ * @return int SUCCESS, FILE_ERROR or INTERNAL_ERROR
+ */
+int net_init(net_t *net, settings_t *settings);
+
+
+/**
+ * @brief Frees network resources of reader (state of circuit breaker is saved)
+ */
+void net_dtor(net_t *net);
+
+
+#endif
@@ -0,0 +1,407 @@
+/**
+ * @file dns.c
+ * @brief Src file of module with resolver, that resolves hosts in advance
+ * (by pool of threads) and caches resolved addresses
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 5. 11. 2022
+ */
+
+#include "dns.h"
+
+
+/**
+ * @brief Finds the entry with given host and port or creates the new one
+ * (lock must be held by the caller)
+ *
+ * @return dns_entry_t* Entry or NULL if there is not enough memory (or host is too long)
+ */
+dns_entry_t *dns_get_entry(dns_shared_t *shared, const char *host, const char *port) {
+    size_t host_len = strlen(host);
+    if(host_len >= 2 && host[0] == '[' && host[host_len - 1] == ']') { //< IPv6 literal (getaddrinfo does not accept brackets)
+        host++;
+        host_len -= 2;
+    }
+
+    if(host_len > MAX_HOST_LEN || strlen(port) > MAX_PORT_LEN) {
+        return NULL;
+    }
+
+    char name[MAX_HOST_LEN + 1];
+    for(size_t i = 0; i < host_len; i++) { //< Host names are case insensitive
+        name[i] = (char)tolower((unsigned char)host[i]);
+    }
+
+    name[host_len] = '\0';
+
+    dns_entry_t *entry = (dns_entry_t *)host_tab_get(&(shared->tab), name, port, true);
+    if(entry && !entry->host[0]) { //< New entry
+        strcpy(entry->host, name);
+        strcpy(entry->port, port);
+    }
+
+    return entry;
+}
+
+
+/**
+ * @brief Checks whether resolved addresses of the entry are too old (lock must be held by the caller)
+ */
+bool dns_is_expired(dns_entry_t *entry) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return entry->done && now.tv_sec >= entry->expires.tv_sec;
+}
+
+
+/**
+ * @brief Prepares the entry for the new resolution (lock must be held by the caller)
+ */
+void dns_reset_entry(dns_entry_t *entry) {
+    if(entry->addrs) { //< Callers of resolver_get have their own copies
+        freeaddrinfo(entry->addrs);
+    }
+
+    entry->addrs = NULL;
+    entry->err = 0;
+    entry->taken = false;
+    entry->done = false;
+}
+
+
+/**
+ * @brief Copies list of addresses to one block of memory (lock must be held by the caller)
+ *
+ * @return struct addrinfo* Copy, that can be freed by free, or NULL if there is not enough memory
+ */
+struct addrinfo *dns_copy_addrs(struct addrinfo *addrs) {
+    size_t n = 0;
+    for(struct addrinfo *cur = addrs; cur; cur = cur->ai_next) {
+        n++;
+    }
+
+    struct addrinfo *copy = (struct addrinfo *)malloc(n*(sizeof(struct addrinfo) + sizeof(struct sockaddr_storage)));
+    if(!copy) {
+        return NULL;
+    }
+
+    struct sockaddr_storage *copied_addrs = (struct sockaddr_storage *)&(copy[n]); //< Addresses are stored behind the list
+    size_t i = 0;
+    for(struct addrinfo *cur = addrs; cur; cur = cur->ai_next, i++) {
+        size_t addr_len = cur->ai_addrlen < sizeof(struct sockaddr_storage) ? cur->ai_addrlen : sizeof(struct sockaddr_storage);
+
+        copy[i] = *cur;
+        memcpy(&(copied_addrs[i]), cur->ai_addr, addr_len);
+        copy[i].ai_addr = (struct sockaddr *)&(copied_addrs[i]);
+        copy[i].ai_addrlen = (socklen_t)addr_len;
+        copy[i].ai_canonname = NULL;
+        copy[i].ai_next = i + 1 < n ? &(copy[i + 1]) : NULL;
+    }
+
+    return copy;
+}
+
+
+/**
+ * @brief Resolves the host of the entry (lock must NOT be held by the caller)
+ */
+void dns_resolve(dns_shared_t *shared, dns_entry_t *entry) {
+    struct addrinfo hints, *addrs = NULL;
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int err = getaddrinfo(entry->host, entry->port, &hints, &addrs); //< Host and port of entry are not modified after its creation
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&(shared->lock));
+    entry->addrs = err ? NULL : addrs;
+    entry->err = err;
+    entry->expires.tv_sec = now.tv_sec + (err ? DNS_NEG_CACHE_TTL : DNS_CACHE_TTL);
+    entry->done = true;
+    pthread_cond_broadcast(&(shared->done_cond));
+    pthread_mutex_unlock(&(shared->lock));
+}
+
+
+/**
+ * @brief Removes one user of the shared state, the last one frees it (lock
+ * must be held by the caller, it is released by this function)
+ */
+void dns_release(dns_shared_t *shared) {
+    bool is_last = --shared->refs == 0;
+    pthread_mutex_unlock(&(shared->lock));
+
+    if(!is_last) {
+        return;
+    }
+
+    for(size_t i = 0; i < shared->tab.cap; i++) {
+        dns_entry_t *entry = (dns_entry_t *)shared->tab.slots[i].data;
+        if(entry && entry->addrs) {
+            freeaddrinfo(entry->addrs);
+        }
+    }
+
+    host_tab_dtor(&(shared->tab));
+
+    pthread_mutex_destroy(&(shared->lock));
+    pthread_cond_destroy(&(shared->job_cond));
+    pthread_cond_destroy(&(shared->done_cond));
+
+    free(shared);
+}
+
+
+/**
+ * @brief Worker, that resolves queued entries until the resolver is stopped
+ */
+void *dns_worker(void *arg) {
+    dns_shared_t *shared = (dns_shared_t *)arg;
+
+    pthread_mutex_lock(&(shared->lock));
+    while(true) {
+        while(!shared->queue_head && !shared->stop) {
+            pthread_cond_wait(&(shared->job_cond), &(shared->lock));
+        }
+
+        if(shared->stop) {
+            break;
+        }
+
+        dns_entry_t *entry = shared->queue_head;
+        shared->queue_head = entry->next_job;
+        if(!shared->queue_head) {
+            shared->queue_tail = NULL;
+        }
+
+        entry->next_job = NULL;
+        if(entry->taken) { //< Entry was already resolved by the thread, that needed it
+            continue;
+        }
+
+        entry->taken = true;
+        shared->busy_num++;
+        pthread_mutex_unlock(&(shared->lock));
+
+        dns_resolve(shared, entry);
+
+        pthread_mutex_lock(&(shared->lock));
+        shared->busy_num--;
+    }
+
+    shared->worker_num--;
+    pthread_cond_broadcast(&(shared->done_cond)); //< Destructor waits for idle workers
+    dns_release(shared);
+
+    return NULL;
+}
+
+
+/**
+ * @brief Starts detached workers, when they are needed for the first time
+ * (lock must be held by the caller)
+ */
+void dns_start_workers(dns_shared_t *shared) {
+    if(shared->started) {
+        return;
+    }
+
+    shared->started = true;
+
+    pthread_attr_t attr; //< Workers are not joined (stuck resolution would block the end of program)
+    if(pthread_attr_init(&attr) || pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED)) {
+        return; //< Hosts are resolved on demand
+    }
+
+    for(; shared->worker_num < DNS_WORKER_NUM; shared->worker_num++) {
+        pthread_t worker;
+        if(pthread_create(&worker, &attr, dns_worker, shared)) {
+            break; //< Hosts are resolved by already running workers (or on demand)
+        }
+
+        shared->refs++;
+    }
+
+    pthread_attr_destroy(&attr);
+}
+
+
+/**
+ * @brief Adds the entry to the queue of entries waiting for resolution (lock
+ * must be held by the caller)
+ *
+ * @param urgent If it is true, entry is inserted to the front of the queue
+ */
+void dns_enqueue(dns_shared_t *shared, dns_entry_t *entry, bool urgent) {
+    if(entry->next_job || shared->queue_tail == entry) { //< Entry is already in the queue
+        return;
+    }
+
+    if(!shared->queue_tail) {
+        shared->queue_head = shared->queue_tail = entry;
+    }
+    else if(urgent) {
+        entry->next_job = shared->queue_head;
+        shared->queue_head = entry;
+    }
+    else {
+        shared->queue_tail->next_job = entry;
+        shared->queue_tail = entry;
+    }
+
+    pthread_cond_signal(&(shared->job_cond));
+}
+
+
+/**
+ * @brief Waits for the end of resolution of the entry (lock must be held by the caller)
+ *
+ * @param timeout_ms Maximum time of waiting in ms (negative value means no limit)
+ * @return true if resolution was finished, false if time is up
+ */
+bool dns_wait(dns_shared_t *shared, dns_entry_t *entry, int timeout_ms) {
+    struct timespec until;
+    clock_gettime(CLOCK_MONOTONIC, &until);
+    until.tv_sec += timeout_ms/1000;
+    until.tv_nsec += (long)(timeout_ms % 1000)*1000000;
+    if(until.tv_nsec >= 1000000000) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+
+    while(!entry->done) {
+        if(timeout_ms < 0) {
+            pthread_cond_wait(&(shared->done_cond), &(shared->lock));
+        }
+        else if(pthread_cond_timedwait(&(shared->done_cond), &(shared->lock), &until) == ETIMEDOUT) {
+            return entry->done;
+        }
+    }
+
+    return true;
+}
+
+
+int resolver_init(resolver_t *resolver) {
+    resolver->shared = NULL;
+
+    dns_shared_t *shared = (dns_shared_t *)calloc(1, sizeof(dns_shared_t));
+    if(!shared) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat strukturu pro resolver!");
+        return INTERNAL_ERROR;
+    }
+
+    host_tab_init(&(shared->tab), sizeof(dns_entry_t));
+    shared->refs = 1;
+
+    pthread_condattr_t attr; //< Deadlines of waiting are given by monotonic clock
+    if(pthread_condattr_init(&attr) || pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) ||
+       pthread_mutex_init(&(shared->lock), NULL) ||
+       pthread_cond_init(&(shared->job_cond), NULL) ||
+       pthread_cond_init(&(shared->done_cond), &attr)) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se inicializovat synchronizaci resolveru!");
+        host_tab_dtor(&(shared->tab));
+        free(shared);
+        return INTERNAL_ERROR;
+    }
+
+    pthread_condattr_destroy(&attr);
+
+    resolver->shared = shared;
+
+    return SUCCESS;
+}
+
+
+void resolver_prefetch(resolver_t *resolver, const char *host, const char *port) {
+    dns_shared_t *shared = resolver->shared;
+    if(!shared) {
+        return;
+    }
+
+    pthread_mutex_lock(&(shared->lock));
+
+    dns_start_workers(shared); //< Workers are started lazily (they are not needed, if there is only one URL)
+    if(shared->worker_num == 0) { //< There is nobody to resolve it in background
+        pthread_mutex_unlock(&(shared->lock));
+        return;
+    }
+
+    dns_entry_t *entry = dns_get_entry(shared, host, port);
+    if(entry && (!entry->taken || dns_is_expired(entry)) && !entry->next_job && shared->queue_tail != entry) {
+        dns_reset_entry(entry);
+        dns_enqueue(shared, entry, false);
+    }
+
+    pthread_mutex_unlock(&(shared->lock));
+}
+
+
+struct addrinfo *resolver_get(resolver_t *resolver, const char *host, const char *port, int timeout_ms, int *err) {
+    dns_shared_t *shared = resolver->shared;
+    pthread_mutex_lock(&(shared->lock));
+
+    dns_entry_t *entry = dns_get_entry(shared, host, port);
+    if(!entry) {
+        pthread_mutex_unlock(&(shared->lock));
+        *err = EAI_MEMORY;
+        return NULL;
+    }
+
+    if(dns_is_expired(entry)) {
+        dns_reset_entry(entry); //< Entry stays in the queue, but workers skip taken entries
+    }
+
+    if(!entry->taken && timeout_ms >= 0) { //< Resolution with time limit must be done by worker (getaddrinfo cannot be interrupted)
+        dns_start_workers(shared);
+    }
+
+    if(!entry->taken && timeout_ms >= 0 && shared->worker_num > 0) {
+        dns_enqueue(shared, entry, true);
+    }
+    else if(!entry->taken) { //< Resolution was not started yet -> it is done by this thread (there is no need to wait for workers)
+        entry->taken = true;
+        pthread_mutex_unlock(&(shared->lock));
+
+        dns_resolve(shared, entry);
+
+        pthread_mutex_lock(&(shared->lock));
+    }
+
+    if(!dns_wait(shared, entry, timeout_ms)) { //< Resolution is finished by worker later (result stays in cache)
+        pthread_mutex_unlock(&(shared->lock));
+        *err = EAI_AGAIN;
+        errno = ETIMEDOUT;
+        return NULL;
+    }
+
+    struct addrinfo *addrs = entry->addrs ? dns_copy_addrs(entry->addrs) : NULL; //< Addresses of entry are freed by the next resolution of the host
+    *err = entry->addrs && !addrs ? EAI_MEMORY : entry->err;
+
+    pthread_mutex_unlock(&(shared->lock));
+
+    return addrs;
+}
+
+
+void resolver_dtor(resolver_t *resolver) {
+    dns_shared_t *shared = resolver->shared;
+    if(!shared) {
+        return;
+    }
+
+    pthread_mutex_lock(&(shared->lock));
+    shared->stop = true;
+    pthread_cond_broadcast(&(shared->job_cond));
+
+    while(shared->worker_num > shared->busy_num) { //< Idle workers end due to stop flag, resolutions, that are still running (e. g. timed out), are not waited for
+        pthread_cond_wait(&(shared->done_cond), &(shared->lock));
+    }
+
+    dns_release(shared);
+    resolver->shared = NULL;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file dns.h
+ * @brief Header file of module with resolver, that resolves hosts in advance
+ * (by pool of threads) and caches resolved addresses
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 5. 11. 2022
+ */
+
+#ifndef _FEEDREADER_DNS_
+#define _FEEDREADER_DNS_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+#include "common.h"
+#include "url.h"
+
+
+#define DNS_WORKER_NUM 8 //< Maximum amount of threads, that resolve hosts concurrently
+#define DNS_CACHE_TTL 300 //< Time in seconds, for which resolved addresses are reused (getaddrinfo does not provide TTL of records)
+#define DNS_NEG_CACHE_TTL 30 //< Time in seconds, for which failed resolution is reused
+
+
+/**
+ * @brief Resolved (or currently resolved) host
+ */
+typedef struct dns_entry {
+    char host[MAX_HOST_LEN + 1]; //< Host (IPv6 literals are without brackets)
+    char port[MAX_PORT_LEN + 1]; //< Port number or service name
+    struct addrinfo *addrs; //< Resolved addresses (or NULL)
+    int err; //< Result of getaddrinfo
+    struct timespec expires; //< Time, when the addresses should be resolved again
+    bool taken; //< Flag signalizing, that resolution was already started
+    bool done; //< Flag signalizing, that resolution is finished
+    struct dns_entry *next_job; //< Next entry in the queue of entries waiting for resolution
+} dns_entry_t;
+
+
+/**
+ * @brief State of resolver shared with its workers
+ * @note It is freed by the last of its users, so workers stuck in getaddrinfo
+ * are not waited for at the end
+ */
+typedef struct dns_shared {
+    host_tab_t tab; //< Table with entries (dns_entry_t)
+    dns_entry_t *queue_head, *queue_tail; //< Queue of entries, that should be resolved by workers
+    size_t worker_num; //< Amount of running workers (0 means, that hosts are resolved only on demand)
+    size_t busy_num; //< Amount of workers, that are resolving a host right now
+    size_t refs; //< Amount of users (resolver and running workers)
+    pthread_mutex_t lock; //< Lock for the table, queue, entries and counters
+    pthread_cond_t job_cond; //< Signalizes new entry in the queue (or stopping of resolver)
+    pthread_cond_t done_cond; //< Signalizes finished resolution (or ended worker)
+    bool started; //< Flag signalizing, that starting of workers was already tried
+    bool stop; //< Flag signalizing, that workers should end
+} dns_shared_t;
+
+
+/**
+ * @brief Resolver with cache of resolved hosts
+ */
+typedef struct resolver {
+    dns_shared_t *shared; //< State shared with workers (NULL if resolver is not initialized)
+} resolver_t;
+
+
+/**
+ * @brief Initializes resolver (workers are started, when they are needed for the first time)
+ * @note If workers cannot be started, hosts are resolved only on demand
+ *
+ * @return int SUCCESS or INTERNAL_ERROR
+ */
+int resolver_init(resolver_t *resolver);
+
+
+/**
+ * @brief Starts resolution of the host in background (if it is not cached yet)
+ */
+void resolver_prefetch(resolver_t *resolver, const char *host, const char *port);
+
+
+/**
+ * @brief Returns resolved addresses of the host (it waits for the prefetched
+ * resolution or resolves the host synchronously)
+ *
+ * @param resolver Resolver
+ * @param host Host name or IP address (IPv6 address can be in brackets)
+ * @param port Port number or service name
+ * @param timeout_ms Maximum time of waiting for the resolution in ms (negative value means no limit)
+ * @param err Output parameter for result of getaddrinfo (EAI_AGAIN and errno
+ * set to ETIMEDOUT if time is up)
+ * @return struct addrinfo* Copy of list of addresses (it must be freed by free) or NULL
+ */
+struct addrinfo *resolver_get(resolver_t *resolver, const char *host, const char *port, int timeout_ms, int *err);
+
+
+/**
+ * @brief Stops workers of resolver and frees all cached addresses (workers,
+ * that are still resolving, are not waited for, they end after the resolution)
+ */
+void resolver_dtor(resolver_t *resolver);
+
+
+#endif
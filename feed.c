@@ -20,82 +20,220 @@ void xml_parser_cleanup() {
 }
 
 
+int feed_parser_init(feed_parser_t *parser) {
+    parser->ctxt = xmlNewParserCtxt(); //< Context with its own dictionary
+    if(!parser->ctxt) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat kontext pro analyzu XML!");
+        return INTERNAL_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+void feed_parser_dtor(feed_parser_t *parser) {
+    if(parser->ctxt) {
+        xmlFreeParserCtxt(parser->ctxt);
+        parser->ctxt = NULL;
+    }
+}
+
+
 void init_feed_doc(feed_doc_t *feed_doc) {
     feed_doc->def_auth_name = NULL;
     feed_doc->src_name = NULL;
     feed_doc->feed = NULL;
+    feed_doc->feed_num = feed_doc->feed_cap = 0;
+    arena_init(&(feed_doc->arena));
 }
 
 
-void add_feed(feed_doc_t *feed_doc, feed_el_t *new_feed) {
-    feed_el_t **feed = &(feed_doc->feed);
+feed_el_t *new_feed(feed_doc_t *feed_doc) {
+    if(feed_doc->feed_num == feed_doc->feed_cap) { //< Array is full -> move it to the twice bigger space in the arena
+        size_t new_cap = feed_doc->feed_cap ? feed_doc->feed_cap*2 : INIT_FEED_CAP;
+        feed_el_t *new_arr = (feed_el_t *)arena_alloc(&(feed_doc->arena), sizeof(feed_el_t)*new_cap);
+        if(!new_arr) {
+            return NULL;
+        }
 
-    while(*feed) { //< Go to the end of the linked list
-        feed = &((*feed)->next);
+        if(feed_doc->feed_num) {
+            memcpy(new_arr, feed_doc->feed, sizeof(feed_el_t)*feed_doc->feed_num);
+        }
+
+        feed_doc->feed = new_arr;
+        feed_doc->feed_cap = new_cap;
     }
 
-    *feed = new_feed;
+    feed_el_t *new_feed_ = &(feed_doc->feed[feed_doc->feed_num++]);
+    memset(new_feed_, 0, sizeof(feed_el_t)); //< Initialization of structure
+
+    return new_feed_;
 }
 
 
-feed_el_t *new_feed(feed_doc_t *feed_doc) {
-    feed_el_t *new_feed_ = (feed_el_t *)malloc(sizeof(feed_el_t));
-    if(!new_feed_) {
-        return NULL;
+void feed_doc_dtor(feed_doc_t *feed_doc) {
+    arena_dtor(&(feed_doc->arena)); //< All entries and their fields are in the arena
+
+    init_feed_doc(feed_doc);
+}
+
+
+/**
+ * @brief Table with known tag names (in lower case) indexed by their perfect hash 
+ */
+static const struct {
+    const char *name;
+    size_t len;
+    tag_id_t id;
+} tag_tab[TAG_HASH_SIZE] = {
+    [TAG_HASH('f', 'd', 4)] = { "feed", 4, TAG_FEED },
+    [TAG_HASH('e', 'y', 5)] = { "entry", 5, TAG_ENTRY },
+    [TAG_HASH('t', 'e', 5)] = { "title", 5, TAG_TITLE },
+    [TAG_HASH('u', 'd', 7)] = { "updated", 7, TAG_UPDATED },
+    [TAG_HASH('l', 'k', 4)] = { "link", 4, TAG_LINK },
+    [TAG_HASH('a', 'r', 6)] = { "author", 6, TAG_AUTHOR },
+    [TAG_HASH('n', 'e', 4)] = { "name", 4, TAG_NAME },
+    [TAG_HASH('r', 's', 3)] = { "rss", 3, TAG_RSS },
+    [TAG_HASH('c', 'l', 7)] = { "channel", 7, TAG_CHANNEL },
+    [TAG_HASH('i', 'm', 4)] = { "item", 4, TAG_ITEM },
+    [TAG_HASH('p', 'e', 7)] = { "pubdate", 7, TAG_PUBDATE },
+};
+
+
+/**
+ * @brief Maps the tag name of XML node to its identifier (it is compared 
+ * only with one known name)
+ * 
+ * @param node Node to be checked
+ * @return tag_id_t Identifier of the tag or TAG_UNKNOWN
+ */
+tag_id_t get_tag_id(xmlNodePtr node) {
+    const xmlChar *name = node->name;
+    if(!name) {
+        return TAG_UNKNOWN;
     }
 
-    memset(new_feed_, 0, sizeof(feed_el_t)); //< Initialization of structure
+    size_t len = 0;
+    for(; name[len] && len <= TAG_MAX_LEN; len++);
+    if(len < TAG_MIN_LEN || len > TAG_MAX_LEN) {
+        return TAG_UNKNOWN;
+    }
 
-    if(feed_doc) {
-        add_feed(feed_doc, new_feed_);
+    int i = TAG_HASH(name[0], name[len - 1], len);
+    if(tag_tab[i].len != len) {
+        return TAG_UNKNOWN;
     }
 
-    return new_feed_;
+    for(size_t j = 0; j < len; j++) { //< Tag names are case insensitive (known names contain only letters, so | 0x20 is enough)
+        if((name[j] | 0x20) != tag_tab[i].name[j]) {
+            return TAG_UNKNOWN;
+        }
+    }
+
+    return tag_tab[i].id;
 }
 
 
-void feed_dtor(feed_el_t *feed) {
-    if(feed) {
-        if(feed->auth_name) xmlFree(feed->auth_name);
-        if(feed->title) xmlFree(feed->title);
-        if(feed->updated) xmlFree(feed->updated);
-        if(feed->url) xmlFree(feed->url);
-        free(feed);
+/**
+ * @brief Computes length of text content of the node (equivalent of
+ * strlen(xmlNodeGetContent(node)) without allocation)
+ */
+size_t content_len(xmlNodePtr node) {
+    size_t len = 0;
+
+    switch(node->type) {
+        case XML_TEXT_NODE:
+        case XML_CDATA_SECTION_NODE:
+            return xmlStrlen(node->content);
+        case XML_ELEMENT_NODE:
+        case XML_ATTRIBUTE_NODE:
+        case XML_ENTITY_DECL:
+            for(xmlNodePtr child = node->children; child; child = child->next) {
+                len += content_len(child);
+            }
+            return len;
+        case XML_ENTITY_REF_NODE: { //< Content of the entity is in its declaration
+            xmlEntityPtr ent = xmlGetDocEntity(node->doc, node->name);
+            return ent ? content_len((xmlNodePtr)ent) : 0;
+        }
+        default:
+            return 0;
     }
 }
 
 
-void feed_doc_dtor(feed_doc_t *feed_doc) {
-    if(feed_doc->def_auth_name) xmlFree(feed_doc->def_auth_name);
-    if(feed_doc->src_name) xmlFree(feed_doc->src_name);
+/**
+ * @brief Copies text content of the node to the given buffer (it must be 
+ * big enough, see content_len)
+ * 
+ * @return xmlChar* Ptr behind the copied content
+ */
+xmlChar *copy_content(xmlNodePtr node, xmlChar *dst) {
+    switch(node->type) {
+        case XML_TEXT_NODE:
+        case XML_CDATA_SECTION_NODE: {
+            size_t len = xmlStrlen(node->content);
+            memcpy(dst, node->content, len);
+            return &(dst[len]);
+        }
+        case XML_ELEMENT_NODE:
+        case XML_ATTRIBUTE_NODE:
+        case XML_ENTITY_DECL:
+            for(xmlNodePtr child = node->children; child; child = child->next) {
+                dst = copy_content(child, dst);
+            }
+            return dst;
+        case XML_ENTITY_REF_NODE: {
+            xmlEntityPtr ent = xmlGetDocEntity(node->doc, node->name);
+            return ent ? copy_content((xmlNodePtr)ent, dst) : dst;
+        }
+        default:
+            return dst;
+    }
+}
 
-    feed_el_t *feed = feed_doc->feed, *tmp;
 
-    while(feed) { //< Deallocate whole linked list
-        tmp = feed;
-        feed = feed->next;
+/**
+ * @brief Gets text content of node (the same as xmlNodeGetContent), but
+ * the content is allocated in the arena
+ * 
+ * @return xmlChar* Content of the node or NULL if allocation failed
+ */
+xmlChar *get_content(arena_t *arena, xmlNodePtr node) {
+    if(!node) {
+        return NULL;
+    }
 
-        feed_dtor(tmp);
+    size_t len = content_len(node);
+    xmlChar *content = (xmlChar *)arena_alloc(arena, len + 1);
+    if(content) {
+        *copy_content(node, content) = '\0';
     }
+
+    return content;
 }
 
 
 /**
- * @brief Determines whether XML node has given name or not
+ * @brief Gets value of attribute (the same as xmlGetProp), but the value is 
+ * allocated in the arena
  * 
- * @param node Node to be checked
- * @param name String against the check is done 
- * @return true If tag name of node is same as given string
- * @return false Otherwise
+ * @return xmlChar* Value of the attribute or NULL if attribute is missing
+ * (or allocation failed)
  */
-bool hasName(xmlNodePtr node, const char *name) {
-    return !xmlStrcasecmp(node->name, (const xmlChar *)name); //< Tag names are case insensitive
+xmlChar *get_prop(arena_t *arena, xmlNodePtr node, const char *name) {
+    xmlAttrPtr attr = xmlHasProp(node, (const xmlChar *)name);
+    if(!attr || attr->type != XML_ATTRIBUTE_NODE) {
+        return NULL;
+    }
+
+    return get_content(arena, (xmlNodePtr)attr);
 }
 
 
 /**
- * @brief Safely sets field of feed structure, if there is any value
- * already it is freed
+ * @brief Safely sets field of feed structure (the previous value is 
+ * owned by the arena, so it is just replaced)
  * 
  * @param field Ptr to the field to be set
  * @param new_content Ptr to the new content of the field
@@ -108,11 +246,6 @@ int set_feed_field(xmlChar **field, xmlChar *new_content, const char *tag) {
         return FEED_ERROR;
     }
 
-    if(*field) { //< Free current content to avoid memory leaks
-        xmlFree(*field);
-        *field = NULL;
-    }
-
     *field = new_content;
 
     return SUCCESS;
@@ -123,22 +256,18 @@ int set_feed_field(xmlChar **field, xmlChar *new_content, const char *tag) {
  * @brief Parses Atom HTML author structure and extracts name from it
  * 
  * @param author The xml node that represents author structure
- * @param cur_feed The ptr to the structure, that should be filled with author name
+ * @param field The ptr to the field, that should be filled with author name
+ * @param arena Arena for the content
  * @return SUCCESS if everything went OK (even if the name of the author was not found)  
  */
-int parse_atom_author(xmlNodePtr author, xmlChar **field) {
+int parse_atom_author(xmlNodePtr author, xmlChar **field, arena_t *arena) {
     int ret = SUCCESS;
     
     xmlNodePtr sub_child = author->children;
 
     while(sub_child) {
-        xmlChar *sub_content = xmlNodeGetContent(sub_child);
-
-        if(hasName(sub_child, "name")) {
-            ret = set_feed_field(field, sub_content, "name");
-        }
-        else {
-            if(sub_content) xmlFree(sub_content);
+        if(get_tag_id(sub_child) == TAG_NAME) {
+            ret = set_feed_field(field, get_content(arena, sub_child), "name");
         }
         if(ret != SUCCESS) {
             break;
@@ -156,49 +285,40 @@ int parse_atom_author(xmlNodePtr author, xmlChar **field) {
  * 
  * @param cur_feed Current feed structure to be filled with data 
  * @param entry 'Root' node of entry
+ * @param arena Arena for the content of fields
  * @return int SUCCESS or FEED_ERROR
  */
-int parse_atom_entry(feed_el_t *cur_feed, xmlNodePtr entry) {
+int parse_atom_entry(feed_el_t *cur_feed, xmlNodePtr entry, arena_t *arena) {
     int ret = SUCCESS;
     xmlNodePtr child;
 
     child = entry->children;
 
     while(child) { //< Try to find given tags
-        xmlChar *content = xmlNodeGetContent(child); //< Get content of child (it can be NULL)
-
-        if(hasName(child, "title")) {
-            ret = set_feed_field(&(cur_feed->title), content, "title");
-        }
-        else if(hasName(child, "updated")) {
-            ret = set_feed_field(&(cur_feed->updated), content, "updated");
-        }
-        else if(hasName(child, "link")) {
-            xmlChar *link = xmlGetProp(child, (xmlChar *)"href");
-            xmlChar *rel = xmlGetProp(child, (xmlChar *)"rel");
-
-            bool is_alt = !rel || !xmlStrcasecmp(rel, (xmlChar *)"alternate");
-            if(is_alt || !(cur_feed->url)) { //< Set the link URL only if link was not defined yet or rel has default value ("alternate") or via
-                if(link) {
-                    ret = set_feed_field(&(cur_feed->url), link, "link");
+        switch(get_tag_id(child)) {
+            case TAG_TITLE:
+                ret = set_feed_field(&(cur_feed->title), get_content(arena, child), "title");
+                break;
+            case TAG_UPDATED:
+                ret = set_feed_field(&(cur_feed->updated), get_content(arena, child), "updated");
+                break;
+            case TAG_LINK: {
+                xmlChar *rel = get_prop(arena, child, "rel");
+
+                bool is_alt = !rel || !xmlStrcasecmp(rel, (xmlChar *)"alternate");
+                if(is_alt || !(cur_feed->url)) { //< Set the link URL only if link was not defined yet or rel has default value ("alternate") or via
+                    xmlChar *link = get_prop(arena, child, "href");
+                    if(link) {
+                        ret = set_feed_field(&(cur_feed->url), link, "link");
+                    }
                 }
+                break;
             }
-            else if(link) {
-                xmlFree(link);
-            }
-            
-            if(rel) {
-                xmlFree(rel);
-            }
-            
-            if(content) xmlFree(content);
-        }
-        else if(hasName(child, "author")) { //< Go inside author tag (there can be name and email)
-            ret = parse_atom_author(child, &(cur_feed->auth_name));
-            if(content) xmlFree(content);
-        }
-        else {
-            if(content) xmlFree(content);
+            case TAG_AUTHOR: //< Go inside author tag (there can be name and email)
+                ret = parse_atom_author(child, &(cur_feed->auth_name), arena);
+                break;
+            default:
+                break;
         }
         if(ret != SUCCESS) {
             break;
@@ -222,37 +342,35 @@ int parse_atom(xmlNodePtr root, feed_doc_t *feed_doc) {
     int ret = SUCCESS;
     feed_el_t *cur_feed;
     xmlNodePtr root_child = root->children;
+    arena_t *arena = &(feed_doc->arena);
 
-    if(hasName(root, "entry")) { //< For standalone entry documents (see RFC4287 p. 26)
+    if(get_tag_id(root) == TAG_ENTRY) { //< For standalone entry documents (see RFC4287 p. 26)
         if(!(cur_feed = new_feed(feed_doc))) {
             printerr(INTERNAL_ERROR, "Nepodarilo se alokovat strukturu pro novinku!");
             return INTERNAL_ERROR;
         }
         
-        ret = parse_atom_entry(cur_feed, root); //< Parse it
+        ret = parse_atom_entry(cur_feed, root, arena); //< Parse it
     }
     else { //< Typical atom source
         while(root_child) { //< Perform search in root child
-            xmlChar *content = xmlNodeGetContent(root_child); //< Get content of child (it can be NULL)
-
-            if(hasName(root_child, "title")) {
-                ret = set_feed_field(&(feed_doc->src_name), content, "title");
-            }
-            else if(hasName(root_child, "author")) { //< Default author is set (see RFC4287 p. 17)
-                ret = parse_atom_author(root_child, &(feed_doc->def_auth_name));
-                if(content) xmlFree(content);
-            }
-            else if(hasName(root_child, "entry")) { //< Entry was found
-                if(!(cur_feed = new_feed(feed_doc))) {
-                    printerr(INTERNAL_ERROR, "Nepodarilo se alokovat strukturu pro novinku!");
-                    return INTERNAL_ERROR;
-                }
+            switch(get_tag_id(root_child)) {
+                case TAG_TITLE:
+                    ret = set_feed_field(&(feed_doc->src_name), get_content(arena, root_child), "title");
+                    break;
+                case TAG_AUTHOR: //< Default author is set (see RFC4287 p. 17)
+                    ret = parse_atom_author(root_child, &(feed_doc->def_auth_name), arena);
+                    break;
+                case TAG_ENTRY: //< Entry was found
+                    if(!(cur_feed = new_feed(feed_doc))) {
+                        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat strukturu pro novinku!");
+                        return INTERNAL_ERROR;
+                    }
                 
-                ret = parse_atom_entry(cur_feed, root_child); //< Parse it
-                if(content) xmlFree(content);
-            }
-            else {
-                if(content) xmlFree(content);
+                    ret = parse_atom_entry(cur_feed, root_child, arena); //< Parse it
+                    break;
+                default:
+                    break;
             }
             if(ret != SUCCESS) {
                 break;
@@ -271,29 +389,29 @@ int parse_atom(xmlNodePtr root, feed_doc_t *feed_doc) {
  * 
  * @param item Pointer to the item node
  * @param cur_feed Feed sctructure to be filled with data
+ * @param arena Arena for the content of fields
  * @return int SUCCESS if everything went OK
  */
-int parse_rss_item(xmlNodePtr item, feed_el_t *cur_feed) {
+int parse_rss_item(xmlNodePtr item, feed_el_t *cur_feed, arena_t *arena) {
     int ret = SUCCESS;
     xmlNodePtr item_child = item->children;
 
     while(item_child) {
-        xmlChar *content = xmlNodeGetContent(item_child);
-
-        if(hasName(item_child, "title")) {
-            ret = set_feed_field(&(cur_feed->title), content, "title");
-        }
-        else if(hasName(item_child, "link")) {
-            ret = set_feed_field(&(cur_feed->url), content, "link");
-        }
-        else if(hasName(item_child, "pubDate")) { //Equivalent of <published> (due to forum)
-            ret = set_feed_field(&(cur_feed->updated), content, "pubDate");
-        }
-        else if(hasName(item_child, "author")) { //Equivalent of Atom <author> structure (due to forum)
-            ret = set_feed_field(&(cur_feed->auth_name), content, "author");
-        }
-        else {
-            if(content) xmlFree(content);
+        switch(get_tag_id(item_child)) {
+            case TAG_TITLE:
+                ret = set_feed_field(&(cur_feed->title), get_content(arena, item_child), "title");
+                break;
+            case TAG_LINK:
+                ret = set_feed_field(&(cur_feed->url), get_content(arena, item_child), "link");
+                break;
+            case TAG_PUBDATE: //Equivalent of <published> (due to forum)
+                ret = set_feed_field(&(cur_feed->updated), get_content(arena, item_child), "pubDate");
+                break;
+            case TAG_AUTHOR: //Equivalent of Atom <author> structure (due to forum)
+                ret = set_feed_field(&(cur_feed->auth_name), get_content(arena, item_child), "author");
+                break;
+            default:
+                break;
         }
         if(ret != SUCCESS) {
             break;
@@ -317,8 +435,9 @@ int parse_rss(xmlNodePtr root, feed_doc_t *feed_doc) {
     int ret = SUCCESS;
     feed_el_t *cur_feed;
     xmlNodePtr channel = root->children, channel_child;  
+    arena_t *arena = &(feed_doc->arena);
 
-    xmlChar *v = xmlGetProp(root, (const xmlChar *)"version"); //< Get version attribute
+    xmlChar *v = get_prop(arena, root, "version"); //< Get version attribute
     if(!v) {
         printerr(FEED_ERROR, "Chybejici atribut znacky 'rss' udavajici verzi RSS protokolu!");
         return FEED_ERROR;
@@ -328,27 +447,27 @@ int parse_rss(xmlNodePtr root, feed_doc_t *feed_doc) {
 
     if(!is_supported) {
         printerr(FEED_ERROR, "Nepodoporovana verze RSS. Podporovana '%s', ziskana '%s'!", RSS_VERSION, v);
-        xmlFree(v);
         return FEED_ERROR;
     }
 
-    xmlFree(v);
-
     while(channel) { //< There should be maximum one and only one channel tag (but ,for better robustness, mutliple of them are accepted )
-        if(hasName(channel, "channel")) {
+        if(get_tag_id(channel) == TAG_CHANNEL) {
             channel_child = channel->children;
 
             while(channel_child) { //< Search all nodes inside channel tag
-                if(hasName(channel_child, "title")) {
-                    xmlChar *cntnt = xmlNodeGetContent(channel_child);
-                    ret = set_feed_field(&(feed_doc->src_name), cntnt, "title");
-                }
-                else if(hasName(channel_child, "item")) {
-                    if(!(cur_feed = new_feed(feed_doc))) {
-                        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro novinku!");
-                        return INTERNAL_ERROR;
-                    }
-                    ret = parse_rss_item(channel_child, cur_feed);
+                switch(get_tag_id(channel_child)) {
+                    case TAG_TITLE:
+                        ret = set_feed_field(&(feed_doc->src_name), get_content(arena, channel_child), "title");
+                        break;
+                    case TAG_ITEM:
+                        if(!(cur_feed = new_feed(feed_doc))) {
+                            printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro novinku!");
+                            return INTERNAL_ERROR;
+                        }
+                        ret = parse_rss_item(channel_child, cur_feed, arena);
+                        break;
+                    default:
+                        break;
                 }
                 if(ret != SUCCESS) {
                     return ret;
@@ -371,11 +490,12 @@ int parse_rss(xmlNodePtr root, feed_doc_t *feed_doc) {
 int sel_parser(xmlNodePtr root, int exp_type, char *url, parse_f_ptr_t *func) {
     int real_mime;
 
-    if(hasName(root, "feed") || hasName(root, "entry")) {
+    tag_id_t root_id = get_tag_id(root);
+    if(root_id == TAG_FEED || root_id == TAG_ENTRY) {
         real_mime = ATOM;
         *func = parse_atom;
     }
-    else if(hasName(root, "rss")) {
+    else if(root_id == TAG_RSS) {
         real_mime = RSS;
         *func = parse_rss;
     }
@@ -394,7 +514,7 @@ int sel_parser(xmlNodePtr root, int exp_type, char *url, parse_f_ptr_t *func) {
 }
 
 
-int parse_feed_doc(feed_doc_t *feed_doc, int exp_type, char *feed, char *url) {
+int parse_feed_doc(feed_parser_t *parser, feed_doc_t *feed_doc, int exp_type, char *feed, size_t feed_len, const char *encoding, char *url) {
     int ret;
 
     int xml_p_flags = XML_PARSE_HUGE | XML_PARSE_RECOVER | XML_PARSE_RECOVER;
@@ -403,7 +523,23 @@ int parse_feed_doc(feed_doc_t *feed_doc, int exp_type, char *feed, char *url) {
         xml_p_flags |= XML_PARSE_NOERROR | XML_PARSE_NOWARNING;
     #endif
 
-    xmlDocPtr xml = xmlReadMemory(feed, strlen(feed), url, NULL, xml_p_flags); //< Parse document by libxml2
+    if(encoding && xmlParseCharEncoding(encoding) == XML_CHAR_ENCODING_ERROR) { //< Encoding is not known by libxml2
+        xmlCharEncodingHandlerPtr handler = xmlFindCharEncodingHandler(encoding); //< It still can be supported via iconv
+        if(!handler) {
+            printw("Nepodporovane kodovani '%s' dokumentu z '%s'! Kodovani bude urceno z dokumentu.", encoding, url);
+            encoding = NULL;
+        }
+        else {
+            xmlCharEncCloseFunc(handler);
+        }
+    }
+
+    if(feed_len > INT_MAX) { //< libxml2 accepts only int as size of the buffer
+        printerr(FEED_ERROR, "Dokument z '%s' je prilis velky!", url);
+        return FEED_ERROR;
+    }
+
+    xmlDocPtr xml = xmlCtxtReadMemory(parser->ctxt, feed, (int)feed_len, url, encoding, xml_p_flags); //< Parse document by libxml2 (context is reset before parsing)
     if(!xml) {
         printerr(FEED_ERROR, "Nepodarilo se provest analyzu dokumentu z '%s'!", url);
         return FEED_ERROR;
@@ -434,35 +570,34 @@ bool is_known(xmlChar *field) {
 }
 
 
-void print_feed_doc(feed_doc_t *feed_doc, settings_t *settings) {
+void print_feed_doc(feed_doc_t *feed_doc, settings_t *settings, FILE *out) {
     
-    printf("*** %s ***\n", is_known(feed_doc->src_name) ? (char *)feed_doc->src_name : "<neznamy zdroj>");
+    fprintf(out, "*** %s ***\n", is_known(feed_doc->src_name) ? (char *)feed_doc->src_name : "<neznamy zdroj>");
+
+    for(size_t i = 0; i < feed_doc->feed_num; i++) {
+        feed_el_t *feed = &(feed_doc->feed[i]);
 
-    feed_el_t *feed = feed_doc->feed;
-    while(feed) {
-        printf("%s\n", is_known(feed->title) ? (char*)feed->title : "<nepojmenovany prispevek>");
+        fprintf(out, "%s\n", is_known(feed->title) ? (char*)feed->title : "<nepojmenovany prispevek>");
 
         if(is_known(feed->auth_name) && settings->author_flag) {
-            printf("Autor: %s\n", feed->auth_name);
+            fprintf(out, "Autor: %s\n", feed->auth_name);
         }
         else if(is_known(feed_doc->def_auth_name) && settings->author_flag) {
-            printf("Autor: %s\n", feed_doc->def_auth_name);
+            fprintf(out, "Autor: %s\n", feed_doc->def_auth_name);
         }
 
 
         if(is_known(feed->url) && settings->asoc_url_flag) {
-            printf("URL: %s\n", feed->url);
+            fprintf(out, "URL: %s\n", feed->url);
         }
         if(is_known(feed->updated) && settings->time_flag) {
-            printf("Aktualizace: %s\n", feed->updated);
+            fprintf(out, "Aktualizace: %s\n", feed->updated);
         }
 
         if(settings->author_flag ||  //< There is newline only if there are any additional information flag
             settings->asoc_url_flag || 
             settings->time_flag) {
-            printf("\n"); 
+            fprintf(out, "\n"); 
         }
-
-        feed = feed->next;
     }
 }
\ No newline at end of file
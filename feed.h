@@ -14,9 +14,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
 
 #include <libxml/parser.h>
 #include <libxml/tree.h>
+#include <libxml/encoding.h>
 
 #include "common.h"
 #include "cli.h"
@@ -26,6 +28,38 @@
 
 #define FORMAT_STRICT //< Always check the name of the root element
 
+#define INIT_FEED_CAP 16 //< Initial capacity of array with entries of feed document
+
+#define TAG_HASH_SIZE 16 //< Size of table with known tag names (must be power of 2)
+#define TAG_MIN_LEN 3 //< Length of the shortest known tag name
+#define TAG_MAX_LEN 7 //< Length of the longest known tag name
+
+/**
+ * @brief Perfect hash of known tag names (case insensitive), it is computed
+ * from first and last character and length of the name
+ * @note Collision of known names is reported by compiler (-Woverride-init)
+ */
+#define TAG_HASH(first, last, len) ((((first) | 0x20)*7 + ((last) | 0x20) + (len)) & (TAG_HASH_SIZE - 1))
+
+
+/**
+ * @brief Identifiers of tags, that are recognized by parsers of feed formats
+ */
+typedef enum tag_id {
+    TAG_UNKNOWN, //< Tag without meaning for parsers
+    TAG_FEED,
+    TAG_ENTRY,
+    TAG_TITLE,
+    TAG_UPDATED,
+    TAG_LINK,
+    TAG_AUTHOR,
+    TAG_NAME,
+    TAG_RSS,
+    TAG_CHANNEL,
+    TAG_ITEM,
+    TAG_PUBDATE,
+} tag_id_t;
+
 
 /**
  * @brief Structure holding all important information about specific feed entry 
@@ -33,23 +67,38 @@
  */
 typedef struct feed_el {
     xmlChar *title, *auth_name, *updated, *url;
-    struct feed_el *next;
 } feed_el_t;
 
 
 /**
- * @brief Linked list with feed entries found in feed doc
+ * @brief Feed document with array of entries found in it
  * 
  */
 typedef struct feed_doc {
     xmlChar *src_name, *def_auth_name; //< Name of the feed doc
-    feed_el_t *feed; //< Ptr to the first feed entry
+    feed_el_t *feed; //< Array with feed entries (in order of the document)
+    size_t feed_num; //< Amount of entries in the array
+    size_t feed_cap; //< Capacity of the array
+    arena_t arena; //< Arena with all entries and their fields (so they are released at once)
 } feed_doc_t;
 
 
 typedef int(* parse_f_ptr_t)(xmlNodePtr, feed_doc_t *); //< Pointer to the parsing function (depends of format)
 
 
+/**
+ * @brief Parser of XML documents, that is reused for all documents of one
+ * worker (its context is only reset between documents)
+ * 
+ * The dictionary of the context is kept by the reset, so names common
+ * to all feeds (item, title, link...) are interned only once and all
+ * parsed documents share it
+ */
+typedef struct feed_parser {
+    xmlParserCtxtPtr ctxt; //< Reusable libxml2 parser context (with its dictionary)
+} feed_parser_t;
+
+
 /**
  * @brief Initializes libxml2 parser library, should be called before
  * any feed is parsed
@@ -67,43 +116,43 @@ void xml_parser_cleanup();
 
 
 /**
- * @brief Initialzes linked list with feed document entries (feed_doc_t) to
- * the initial value
+ * @brief Creates parser context, that can be used for parsing of multiple documents
  * 
- * @param feed_doc STructure to be initialized
+ * @param parser Parser to be initialized
+ * @return int SUCCESS or INTERNAL_ERROR
  */
-void init_feed_doc(feed_doc_t *feed_doc);
+int feed_parser_init(feed_parser_t *parser);
 
 
 /**
- * @brief Append feed entry to the end of linked list
+ * @brief Frees parser context (documents parsed by it must be already freed)
  * 
- * @param feed_doc Feed document (linked list)
- * @param new_feed Feed to be added
+ * @param parser Parser to be freed
  */
-void add_feed(feed_doc_t *feed_doc, feed_el_t *new_feed);
+void feed_parser_dtor(feed_parser_t *parser);
 
 
 /**
- * @brief Allocates element for the new feed entry and adds it
- * to the given feed doc
+ * @brief Initialzes feed document structure (feed_doc_t) to the initial value
  * 
- * @param feed_doc Target feed doc (or NULL)
- * @return feed_el_t* Ptr the newly allocated element or NULL (should be checked)
+ * @param feed_doc STructure to be initialized
  */
-feed_el_t *new_feed(feed_doc_t *feed_doc);
+void init_feed_doc(feed_doc_t *feed_doc);
 
 
 /**
- * @brief Feed entry deallocator (should be called instead of simple free func)
+ * @brief Appends the new (empty) entry to the end of array with entries 
+ * of the given feed doc (array is extended if it is necessary)
  * 
- * @param feed Feed entry to be deallocated
+ * @param feed_doc Target feed doc
+ * @return feed_el_t* Ptr the new element or NULL (should be checked)
+ * @warning Returned ptr is valid only until the next call of this function
  */
-void feed_dtor(feed_el_t *feed);
+feed_el_t *new_feed(feed_doc_t *feed_doc);
 
 
 /**
- * @brief Deallocates feed document structure
+ * @brief Deallocates feed document structure (with all its entries at once)
  * 
  * @param feed_doc Feed document to be deallocated
  */
@@ -113,13 +162,16 @@ void feed_doc_dtor(feed_doc_t *feed_doc);
 /**
  * @brief Parses XML document with feed, the format is determined by the root tag
  * 
+ * @param parser Parser, that should be used for parsing
  * @param feed_doc Feed document structure to be filled by the data from parsed document
  * @param exp_type Code of expected format of the feed document
  * @param feed Pointer to buffer with document that should be parsed
+ * @param feed_len Length of the document (it does not have to be null terminated)
+ * @param encoding Encoding declared by the source of document (or NULL, then it is detected by parser)
  * @param url Source URL of XML document
  * @return int SUCCESS if parsing went OK
  */
-int parse_feed_doc(feed_doc_t *feed_doc, int exp_type, char *feed, char *url);
+int parse_feed_doc(feed_parser_t *parser, feed_doc_t *feed_doc, int exp_type, char *feed, size_t feed_len, const char *encoding, char *url);
 
 
 /**
@@ -131,12 +183,13 @@ bool is_known(xmlChar *field);
 
 
 /**
- * @brief Prints formatted feed to stdout
+ * @brief Prints formatted feed to the given stream (usually stdout)
  * @note To change format of output, modify this function
  * 
  * @param feed_doc Structure with information from feed document that should be printed
  * @param settings Settings structure to determine which information should be printed
+ * @param out Output stream
  */
-void print_feed_doc(feed_doc_t *feed_doc, settings_t *settings);
+void print_feed_doc(feed_doc_t *feed_doc, settings_t *settings, FILE *out);
 
 #endif
@@ -10,25 +10,20 @@
 
 
 /**
- * @brief Auxiliary function, that moves string buffer to linked list as a 
- * new element
+ * @brief Auxiliary function, that copies the content of buffer to the table
+ * with URLs as a new original URL
  * 
- * @param buffer Buffer its value should be copied to the element of list
- * @param dst_list Target list
+ * @param buffer Buffer its value should be copied to the table
+ * @param len Length of the URL in the buffer
+ * @param dst_tab Target table
  * @return int SUCCESS if moving went OK
  */
-int move_to_list(string_t *buffer, list_t *dst_list) {
-    list_el_t *new_url = new_element(buffer->str);
-    if(!new_url) {
-        printerr(INTERNAL_ERROR, "Nepodarilo se presunout '%s' do seznamu!", buffer->str);
+int move_to_tab(string_t *buffer, size_t len, url_tab_t *dst_tab) {
+    if(url_tab_append(dst_tab, buffer->str, len, 0) == URL_TAB_NONE) { //< Indirection level 0 - it is original URL
+        printerr(INTERNAL_ERROR, "Nepodarilo se presunout '%.*s' do tabulky!", (int)len, buffer->str);
         return INTERNAL_ERROR;
     }
 
-    new_url->result = SUCCESS;
-    new_url->indirect_lvl = 0; //< It is original URL
-
-    list_append(dst_list, new_url);
-
     return SUCCESS;
 }
 
@@ -41,8 +36,8 @@ int move_to_list(string_t *buffer, list_t *dst_list) {
  * @return 0 if settings structure is correct, otherwise error code
  */
 int validate_settings(settings_t *settings) {
-    if(!settings->url && !settings->feedfile) {
-        printerr(USAGE_ERROR, "Je vyzadovana URL nebo soubor s adresami!");
+    if(!settings->url && !settings->feedfile && !settings->feeddir) {
+        printerr(USAGE_ERROR, "Je vyzadovana URL, soubor s adresami nebo slozka se soubory!");
         print_usage();
         return USAGE_ERROR;
     }
@@ -51,36 +46,39 @@ int validate_settings(settings_t *settings) {
         print_usage();
         return USAGE_ERROR;
     }
+    else if(settings->feeddir && (settings->url || settings->feedfile)) {
+        printerr(USAGE_ERROR, "Nelze specifikovat slozku se soubory zaroven s URL nebo souborem s adresami!");
+        print_usage();
+        return USAGE_ERROR;
+    }
 
     return SUCCESS;
 }
 
 
 /**
- * @brief Processes character from the feedfile to create the list with URLs
+ * @brief Processes character from the feedfile to create the table with URLs
  * 
  * @param c Character to be processed
  * @param buff Buffer with URL
- * @param list URL list
+ * @param tab URL table
  * @param len Ptr to the length of string in the buffer
  * @param is_cmnt Comment flag (line is ignored if there is '#' as first non-whitepsace character)
  * @return int SUCESS if processing went OK
  */
-int proc_char(char c, string_t *buff, list_t *list, int *len, bool *is_cmnt) {
+int proc_char(char c, string_t *buff, url_tab_t *tab, size_t *len, bool *is_cmnt) {
     int ret;
 
     if(c == '\n') {
         *is_cmnt = false;
     }
 
-    if(*len > 0 && c == '\n') { //< If there is newline and buffer is not empty -> move URL to the list
-        if((ret = move_to_list(buff, list)) != SUCCESS) {
-            printerr(INTERNAL_ERROR, "Nepodarilo se presunout URL do seznamu!");
-            return INTERNAL_ERROR;
+    if(*len > 0 && c == '\n') { //< If there is newline and buffer is not empty -> move URL to the table
+        if((ret = move_to_tab(buff, *len, tab)) != SUCCESS) {
+            return ret;
         }
 
-        erase_string(buff); //< Clear buffer
-        *len = 0;
+        *len = 0; //< Clear buffer (only the length is important)
     }
     else if((*len == 0 && c == '\n') || isspace(c) || *is_cmnt) { //< Characters to be ignored
         return SUCCESS;
@@ -89,12 +87,12 @@ int proc_char(char c, string_t *buff, list_t *list, int *len, bool *is_cmnt) {
         *is_cmnt = true;
     }
     else { //< Regular character
-        if(!(buff = app_char(&buff, c))) {
+        if(*len + 1 >= buff->size && !ext_string(buff)) {
             printerr(INTERNAL_ERROR, "Neocekavana chyba pri analyze souboru s adresami!");
             return INTERNAL_ERROR;
         }
 
-        (*len)++;
+        buff->str[(*len)++] = c;
     }
 
     return SUCCESS;
@@ -102,85 +100,153 @@ int proc_char(char c, string_t *buff, list_t *list, int *len, bool *is_cmnt) {
 
 
 /**
- * @brief Parses feedfile (text file with URL) and creates URL list from it
+ * @brief Closes feedfile (standard input is left open) and frees its resources
+ */
+void feedfile_close(feedfile_t *src) {
+    if(src->fd > STDIN_FILENO) {
+        close(src->fd);
+    }
+
+    if(src->line) {
+        string_dtor(src->line);
+    }
+
+    src->fd = -1;
+    src->line = NULL;
+}
+
+
+/**
+ * @brief Opens feedfile for streaming (path "-" means standard input)
  * 
+ * @param src Structure to be initialized
  * @param path Path to the feedfile
- * @param url_list Output structure with URLs from feedfile 
- * @return int SUCCESS if everything was OK
+ * @return int SUCCESS if feedfile was opened
  */
-int parse_feedfile(char *path, list_t *url_list) {
-    FILE *file_ptr = fopen(path, "r");
-    if(!file_ptr) {
+int feedfile_open(feedfile_t *src, char *path) {
+    memset(src, 0, sizeof(feedfile_t));
+    src->path = path;
+
+    if(!strcmp(path, FEEDFILE_STDIN)) {
+        src->fd = STDIN_FILENO;
+    }
+    else if((src->fd = open(path, O_RDONLY)) < 0) {
         printerr(FILE_ERROR, "%s (%s)", path, strerror(errno));
         return FILE_ERROR;
     }
 
-    string_t *buffer = new_string(INIT_STRING_SIZE); //< Buffer for the file content
-    if(!buffer) {
+    src->line = new_string(INIT_STRING_SIZE); //< Buffer for the currently processed line
+    if(!src->line) {
         printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro analyzu souboru s adresami!");
-        fclose(file_ptr);
+        feedfile_close(src);
         return INTERNAL_ERROR;
     }
 
-    int ret, c, len = 0;
-    bool is_cmnt = false;
-    while((c = fgetc(file_ptr)) != EOF) { //< PArse file char by char
-        if((ret = proc_char(c, buffer, url_list, &len, &is_cmnt)) != SUCCESS) {
-            fclose(file_ptr);
-            return ret;
-        }
-    }
+    return SUCCESS;
+}
 
-    if(len > 0) { //< There is EOF without LF before (it shouldn't cause it is abnormal in UNIX text files)
-        if((ret = move_to_list(buffer, url_list)) != SUCCESS) {
-            fclose(file_ptr);
-            return ret;
+
+/**
+ * @brief Reads feedfile until the next URL is found and moves it to the table
+ * @note Data are read by chunks (read returns as soon as some data are available,
+ * so URLs from pipes are processed immediately after their line is complete)
+ * 
+ * @param src Opened feedfile
+ * @param url_tab Output table (if there is no URL left in feedfile, table is not modified)
+ * @param timeout_ms Maximum time of waiting for new data (-1 means no limit,
+ * 0 means, that only already read chunk is processed)
+ * @return int SUCCESS if everything was OK
+ */
+int feedfile_next(feedfile_t *src, url_tab_t *url_tab, int timeout_ms) {
+    size_t orig_num = url_tab->num;
+    int ret;
+
+    while(url_tab->num == orig_num) {
+        if(src->pos < src->end) {
+            ret = proc_char(src->chunk[src->pos++], src->line, url_tab, &(src->len), &(src->is_cmnt));
+            if(ret != SUCCESS) {
+                return ret;
+            }
+
+            continue;
         }
+        else if(src->eof) {
+            if(src->len > 0) { //< There is EOF without LF before (it shouldn't cause it is abnormal in UNIX text files)
+                size_t len = src->len;
+                src->len = 0;
+                return move_to_tab(src->line, len, url_tab);
+            }
 
-        erase_string(buffer); //< Clear buffer
-    }
+            break;
+        }
+        else if(timeout_ms == 0) { //< Only already read data can be processed
+            break;
+        }
+        else if(timeout_ms > 0) {
+            struct pollfd pfd = { .fd = src->fd, .events = POLLIN };
+            int ready = poll(&pfd, 1, timeout_ms);
+            if(ready == 0) { //< Nothing arrived in time
+                break;
+            }
+            else if(ready < 0 && errno == EINTR) {
+                continue;
+            }
+        }
 
-    #ifdef DEBUG //Prints all urls from url list
-        fprintf(stderr, "Found\n");
-        list_el_t *current = url_list->header;
-        while(current)
-        {
-            fprintf(stderr, "url: %s\n", current->string->str);
-            current = current->next;
+        ssize_t newly_read_b = read(src->fd, src->chunk, FEEDFILE_CHUNK_SIZE);
+        if(newly_read_b < 0 && errno == EINTR) {
+            continue;
+        }
+        else if(newly_read_b < 0) {
+            printerr(FILE_ERROR, "Chyba pri cteni souboru s adresami '%s'! (%s)", src->path, strerror(errno));
+            return FILE_ERROR;
         }
-    #endif
 
-    string_dtor(buffer);
-    fclose(file_ptr);
+        src->pos = 0;
+        src->end = (size_t)newly_read_b;
+        src->eof = newly_read_b == 0;
+    }
 
     return SUCCESS;
 }
 
 
+/**
+ * @brief Checks whether the whole feedfile was read and all its URLs were moved to the table
+ */
+bool feedfile_is_read(feedfile_t *src) {
+    return src->eof && src->pos >= src->end && src->len == 0;
+}
+
+
 /**
  * @brief Parses and prints feed from specific URL
  * 
  * @param feed Pointer to feed to be parsed
+ * @param feed_len Length of the feed document
  * @param exp_type Expected MIME type of the document
+ * @param encoding Encoding declared by the source (or NULL)
  * @param settings 
  * @param url Source URL
+ * @param parser Parser of XML documents
+ * @param out Output stream for formatted feed
  * @return int SUCCESS if everything went OK
  */
-int parse_and_print(char *feed, int exp_type, settings_t *settings, char *url) {
+int parse_and_print(char *feed, size_t feed_len, int exp_type, char *encoding, settings_t *settings, char *url, feed_parser_t *parser, FILE *out) {
     int ret;
     feed_doc_t feed_doc;
     init_feed_doc(&feed_doc);
 
-    ret = parse_feed_doc(&feed_doc, exp_type, feed, url);
+    ret = parse_feed_doc(parser, &feed_doc, exp_type, feed, feed_len, encoding, url);
     if(ret != SUCCESS) {
         feed_doc_dtor(&feed_doc);
         return ret;
     }
 
-    print_feed_doc(&feed_doc, settings);
+    print_feed_doc(&feed_doc, settings, out);
     
-    if(settings->feedfile) {
-        printf("\n");
+    if(settings->feedfile || settings->feeddir) { //< Documents from multiple sources are separated by empty line
+        fprintf(out, "\n");
     }
 
     feed_doc_dtor(&feed_doc);
@@ -190,61 +256,74 @@ int parse_and_print(char *feed, int exp_type, settings_t *settings, char *url) {
 
 
 /**
- * @brief Reads feed from file in filesystem of localhost 
+ * @brief Reads file with given path to the buffer (content of regular file
+ * is read to one segment, so it is contiguous without copying)
  */
-int load_from_file(url_t *p_url, string_t *data_buff) {
-    char *path = p_url->url_parts[PATH]->str;
+int load_file(char *path, seg_buff_t *data_buff) {
     FILE *src = fopen(path, "r");
     if(!src) {
         printerr(FILE_ERROR, "Nepodarilo se otevrit soubor '%s'! (%s)", path, strerror(errno));
         return FILE_ERROR;
     }
 
-    size_t b_read = 0, newly_read_b = 1, empty_size = data_buff->size;
-    size_t last_size = data_buff->size;
+    struct stat src_stat;
+    if(!fstat(fileno(src), &src_stat) && S_ISREG(src_stat.st_mode) && src_stat.st_size > 0) { //< File is not mapped (truncation of mapped file during parsing would cause SIGBUS)
+        seg_reserve(data_buff, (size_t)src_stat.st_size + 1); //< Extra byte for detection of EOF, if it fails, content is read to ordinary segments
+    }
+
+    struct iovec iov;
+    while(!feof(src)) { //< Read until EOF is found (size of the file could change after fstat)
+        if(!seg_iov(data_buff, &iov, 1)) { //< Get free space at the end of the buffer
+            printerr(INTERNAL_ERROR, "Nepodarilo se rozsirit buffer pro data!");
+            fclose(src);
+            return INTERNAL_ERROR;
+        }
 
-    while(!feof(src)) { //< Read until EOF is found
-        char *mem_dest = &(data_buff->str[b_read]);
-        newly_read_b = fread(mem_dest, sizeof(char), empty_size, src);
+        size_t newly_read_b = fread(iov.iov_base, sizeof(char), iov.iov_len, src);
         if(newly_read_b == 0 && !feof(src)) {
             printerr(FILE_ERROR, "Chyba pri cteni dat z '%s'!", path);
+            fclose(src);
             return FILE_ERROR;
         }
 
-        b_read += newly_read_b;
-        empty_size -= newly_read_b;
-        if(empty_size == 0) { //< If there is no place for the new characters -> extend buffer
-            if((data_buff = ext_string(data_buff)) == NULL) {
-                printerr(INTERNAL_ERROR, "Nepodarilo se rozsirit buffer pro data!");
-                fclose(src);
-                return INTERNAL_ERROR;
-            }
-
-            empty_size = data_buff->size - last_size;
-        }
+        seg_commit(data_buff, newly_read_b);
     }
 
     fclose(src);
 
     #ifdef DEBUG
-        fprintf(stderr, "File content:\n%s\n\n", data_buff->str);
+        fprintf(stderr, "File content (%ld B) from '%s'\n\n", data_buff->total, path);
     #endif
 
     return SUCCESS;
 }
 
 
+/**
+ * @brief Reads feed from file in filesystem of localhost 
+ */
+int load_from_file(url_t *p_url, seg_buff_t *data_buff) {
+    char path[FILENAME_MAX];
+    if(!url_part_cstr(p_url, PATH, path, FILENAME_MAX)) {
+        printerr(FILE_ERROR, "Prilis dlouha cesta k souboru v '%.*s'!", (int)p_url->url_parts[PATH].len, p_url->url_parts[PATH].st);
+        return FILE_ERROR;
+    }
+
+    return load_file(path, data_buff);
+}
+
+
 /**
  * @brief Fetches data from various sources
  */
-int load_data(url_t *p_url, string_t *data_buff, char *url, settings_t *s) {
+int load_data(url_t *p_url, seg_buff_t *data_buff, h_resp_t *p_resp, char *url, settings_t *s, net_t *net) {
     switch(p_url->type) {
         case FILE_SRC:
             return load_from_file(p_url, data_buff);
         case HTTPS_SRC:
-            return https_load(p_url, data_buff, url, s);
+            return https_load(p_url, data_buff, p_resp, url, s, net);
         case HTTP_SRC:
-            return http_load(p_url, data_buff, url);
+            return http_load(p_url, data_buff, p_resp, url, s, net);
         default:
             printerr(URL_ERROR, "Nepodporovany typ zdroje ('%s')!", url);
             return URL_ERROR;
@@ -253,35 +332,41 @@ int load_data(url_t *p_url, string_t *data_buff, char *url, settings_t *s) {
 
 
 /**
- * @brief Parses and checks the raw data that came from HTTP connection
+ * @brief Checks the HTTP response (its headers are analysed during receiving)
+ * and finds the message with document
  * 
  */
-int parse_http_data(data_ctx_t *ctx, list_el_t *current, string_t *data_buff) {
-    h_resp_t parsed_resp;
-    init_h_resp(&parsed_resp);
-
-    erase_h_resp(&parsed_resp);
-    int ret = parse_http_resp(&parsed_resp, data_buff, ctx->url); //< Firstly, we must extract the headers and so on
+int parse_http_data(data_ctx_t *ctx, url_tab_t *tab, size_t cur, h_resp_t *p_resp, seg_buff_t *data_buff) {
+    int ret = check_http_resp(p_resp, tab, cur, ctx->url); //< Response is checked (especilly the status is checked)
     if(ret != SUCCESS) {
         return ret;
     }
+    else if(p_resp->msg_skipped) { //< Should not happen (message is skipped only if the response is rejected by check above)
+        printerr(INTERNAL_ERROR, "Zprava HTTP odpovedi z '%s' nebyla prijata!", ctx->url);
+        return INTERNAL_ERROR;
+    }
 
-    ret = check_http_resp(&parsed_resp, current, ctx->url); //< Then is response checked (especilly the status is checked)
-    if(ret != SUCCESS) {
-        return ret;
+    size_t msg_len;
+    p_resp->msg = seg_flatten(data_buff, p_resp->hdr_len, &msg_len); //< Parsers need contiguous data (it is copied only if it is necessary)
+    if(!p_resp->msg) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro data z '%s'!", ctx->url);
+        return INTERNAL_ERROR;
     }
 
-    ctx->exp_type = parsed_resp.doc_type;
-    ctx->doc_start = parsed_resp.msg;
+    ctx->exp_type = p_resp->doc_type;
+    ctx->encoding = p_resp->charset[0] ? p_resp->charset : NULL; //< Charset from Content-Type has precedence (see RFC7303)
+    ctx->doc_start = p_resp->msg;
+    ctx->doc_len = msg_len;
 
     #ifdef DEBUG
+        char *data = data_buff->head->data;
         fprintf(stderr, "HTTP hdr position:\n");
-        fprintf(stderr, "Version: %ld %ld\n", parsed_resp.version.st - data_buff->str, parsed_resp.version.len);
-        fprintf(stderr, "Status: %ld %ld\n", parsed_resp.status.st - data_buff->str, parsed_resp.status.len);
-        fprintf(stderr, "Phrase: %ld %ld\n", parsed_resp.phrase.st - data_buff->str, parsed_resp.phrase.len);
-        fprintf(stderr, "Location: %ld %ld\n", parsed_resp.location.st - data_buff->str, parsed_resp.location.len);
-        fprintf(stderr, "Content-Type: %ld %ld\n", parsed_resp.content_type.st - data_buff->str, parsed_resp.content_type.len);
-        //fprintf(stderr, "Msg: %s\n", parsed_resp.msg);
+        fprintf(stderr, "Version: %ld %ld\n", p_resp->version.st - data, p_resp->version.len);
+        fprintf(stderr, "Status: %ld %ld\n", p_resp->status.st - data, p_resp->status.len);
+        fprintf(stderr, "Phrase: %ld %ld\n", p_resp->phrase.st - data, p_resp->phrase.len);
+        fprintf(stderr, "Location: %ld %ld\n", p_resp->location.st - data, p_resp->location.len);
+        fprintf(stderr, "Content-Type: %ld %ld\n", p_resp->content_type.st - data, p_resp->content_type.len);
+        fprintf(stderr, "Message: %ld %ld\n", p_resp->hdr_len, msg_len);
     #endif
 
     return ret;
@@ -291,23 +376,27 @@ int parse_http_data(data_ctx_t *ctx, list_el_t *current, string_t *data_buff) {
 /**
  * @brief Makes analysis of data that came from various sources 
  */
-int parse_data(data_ctx_t *ctx, list_el_t *current, string_t *data_buff) {
+int parse_data(data_ctx_t *ctx, url_tab_t *tab, size_t cur, h_resp_t *p_resp, seg_buff_t *data_buff) {
     int ret = SUCCESS;
 
-    char *scheme = ctx->parsed_url->url_parts[SCHEME_PART]->str;
+    string_slice_t *scheme = &(ctx->parsed_url->url_parts[SCHEME_PART]);
     src_type_t src_type = ctx->parsed_url->type;
 
     switch(src_type) {
         case HTTP_SRC: //< HTTP protocol
         case HTTPS_SRC:
-            ret = parse_http_data(ctx, current, data_buff);
+            ret = parse_http_data(ctx, tab, cur, p_resp, data_buff);
             break;
         case FILE_SRC: //< There is no wrapping protocol or something like that
-            ctx->doc_start = data_buff->str;
+            ctx->doc_start = seg_flatten(data_buff, 0, &(ctx->doc_len));
             ctx->exp_type = XML;
+            if(!ctx->doc_start) {
+                printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro data z '%s'!", ctx->url);
+                return INTERNAL_ERROR;
+            }
             break;
         default:
-            printerr(URL_ERROR, "Nepodporovany typ zdroje '%s'!", scheme);
+            printerr(URL_ERROR, "Nepodporovany typ zdroje '%.*s'!", (int)scheme->len, scheme->st);
             return URL_ERROR;
     }
 
@@ -316,57 +405,496 @@ int parse_data(data_ctx_t *ctx, list_el_t *current, string_t *data_buff) {
 
 
 /**
- * @brief Performs the general functionality of the program - parsing and 
- * printing formatted feed from all specified source
+ * @brief Loads, parses and prints feed from the URL
  * 
- * @param url_list List with URLs to feed documents 
+ * @param tab Table with URLs
+ * @param cur Index of the URL in the table
+ * @param reader Reusable resources
  * @param settings Settings of the program
- * @return int SUCCESS if everything went OK, otherwise INTERNAL ERROR
- * @note If problem occurs while parsing URL or XML from source, result field
- * in related list_el_t is modified, but processing of other URLs continues
+ * @param out Output stream for formatted feed
+ * @return int SUCCESS if everything went OK (or if URL was redirected)
+ */
+int fetch_url(url_tab_t *tab, size_t cur, reader_t *reader, settings_t *settings, FILE *out) {
+    int ret;
+    char *url = tab->url[cur]; //< Content of URLs is in arena (it is not moved by extension of table)
+    url_t *parsed_url = &(reader->parsed_url);
+
+    seg_buff_reset(&(reader->data_buff));
+    init_h_resp(&(reader->parsed_resp));
+    ret = load_data(parsed_url, &(reader->data_buff), &(reader->parsed_resp), url, settings, &(reader->net)); //< Loading data (XML doc)
+    if(ret != SUCCESS) {
+        return ret;
+    }
+
+    data_ctx_t ctx = { .url = url, .parsed_url = parsed_url, .encoding = NULL };
+    ret = parse_data(&ctx, tab, cur, &(reader->parsed_resp), &(reader->data_buff));
+    if(ret == HTTP_REDIRECT) {
+        return SUCCESS;
+    }
+    else if(ret != SUCCESS) {
+        return ret;
+    }
+
+    return parse_and_print(ctx.doc_start, ctx.doc_len, ctx.exp_type, ctx.encoding, settings, url, &(reader->parser), out);
+}
+
+
+/**
+ * @brief Uses result of the URL, that was already processed (the output is 
+ * printed again or the same redirection is performed)
+ */
+int replay_result(url_cache_entry_t *cached, url_tab_t *tab, size_t cur, FILE *dst) {
+    if(cached->redir) {
+        return http_redirect_to(tab, cur, cached->redir, strlen(cached->redir));
+    }
+
+    if(cached->out) {
+        fwrite(cached->out, sizeof(char), cached->out_len, dst);
+    }
+
+    if(cached->result != SUCCESS && cached->err_msg) { //< Original error message is printed again
+        printerr(cached->result, "%s", cached->err_msg);
+    }
+    else if(cached->result != SUCCESS) {
+        printerr(cached->result, "Zdroj '%s' byl jiz zpracovan neuspesne!", tab->url[cur]);
+    }
+
+    return cached->result;
+}
+
+
+/**
+ * @brief Stores the result of processed URL to the cache (ownership of the 
+ * output is taken by the cache, or it is freed)
+ */
+void cache_result(reader_t *reader, url_tab_t *tab, size_t cur, size_t canon_len, int result, char *out, size_t out_len) {
+    url_cache_t *cache = &(reader->cache);
+
+    //< Results on the end of too long chains are not cached, because they depend on the chain
+    bool is_cacheable = canon_len > 0 && tab->indirect_lvl[cur] < MAX_REDIR_NUM &&
+                        cache->out_total + out_len <= MAX_CACHED_OUT_SIZE;
+
+    url_cache_entry_t *entry = is_cacheable ? url_cache_insert(cache, reader->canon->str, canon_len) : NULL;
+    if(!entry) { //< URL will be fetched again if it occurs again
+        free(out);
+        return;
+    }
+
+    entry->result = result;
+    if(result != SUCCESS && last_err()[0]) {
+        entry->err_msg = arena_strndup(&(cache->strs), last_err(), strlen(last_err()));
+    }
+
+    if(tab->redir[cur] != URL_TAB_NONE) {
+        char *redir_url = tab->url[tab->redir[cur]];
+        entry->redir = arena_strndup(&(cache->strs), redir_url, strlen(redir_url));
+    }
+
+    entry->out = out;
+    entry->out_len = out_len;
+    cache->out_total += out_len;
+}
+
+
+/**
+ * @brief Checks whether the error may disappear if the request is repeated
+ * (failed resolution is cached by resolver, so it would fail again)
+ */
+bool is_transient(int ret, net_t *net) {
+    return ret == COMMUNICATION_ERROR || (ret == CONNECTION_ERROR && net->last_fail != CONN_FAIL_UNRESOLVED);
+}
+
+
+/**
+ * @brief Reads feed from the URL (each resource is fetched only once, results 
+ * of URLs with the same canonical form are taken from the cache)
+ * 
+ * @param tab Table with URLs
+ * @param cur Index of the URL in the table
+ * @param reader Reusable resources
+ * @param settings Settings of the program
+ * @param dst Output stream for formatted feed
+ * @return int Result code of processing (redirection is considered as SUCCESS,
+ * because the result of redirection is stored in the new entry of table)
+ * @note URL table can be extended by redirection, so pointers to its columns
+ * are not valid after calling this function
  */
-int do_feedread(list_t *url_list, settings_t *settings) {
-    url_t parsed_url;
-    init_url(&parsed_url);
+int read_url(url_tab_t *tab, size_t cur, reader_t *reader, settings_t *settings, FILE *dst) {
+    int ret;
+    url_t *parsed_url = &(reader->parsed_url);
+
+    reader->transient = false;
+    erase_url(parsed_url);
+    if((ret = parse_url(tab->url[cur], parsed_url)) != SUCCESS) { //< Parsing of URL (with default scheme 'https://')
+        return ret;
+    }
+
+    size_t canon_len = url_canon(parsed_url, reader->canon);
+    url_cache_entry_t *cached = canon_len > 0 ? url_cache_find(&(reader->cache), reader->canon->str, canon_len) : NULL;
+    if(cached) {
+        return replay_result(cached, tab, cur, dst);
+    }
+
+    const char *memo_target = canon_len > 0 ? redir_memo_find(&(reader->memo), reader->canon->str, canon_len) : NULL;
+    if(memo_target) { //< Original location is not requested
+        printw("Pouzito ulozene trvale presmerovani zdroje '%s'!", tab->url[cur]);
+        return http_redirect_to(tab, cur, memo_target, strlen(memo_target));
+    }
 
-    string_t *data_buff = new_string(INIT_NET_BUFF_SIZE);
-    if(!data_buff) {
-        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro data!");
+    char *out = NULL;
+    size_t out_len = 0;
+    FILE *out_stream = open_memstream(&out, &out_len); //< Output is captured to be reused by duplicate URLs
+    if(!out_stream) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro vystup z '%s'!", tab->url[cur]);
         return INTERNAL_ERROR;
     }
 
-    openssl_init();
+    clear_last_err();
+    ret = fetch_url(tab, cur, reader, settings, out_stream);
+    reader->transient = is_transient(ret, &(reader->net));
+    fclose(out_stream);
 
-    list_el_t *current = url_list->header;
-    for(; current; current = current->next) { //< Parse URL, load document and parse it for every URL in linked list
-        int *ret = &(current->result);
-        char *url = current->string->str;
+    if(ret == SUCCESS && canon_len > 0 && tab->redir[cur] != URL_TAB_NONE && is_permanent_redir(&(reader->parsed_resp))) {
+        redir_memo_put(&(reader->memo), reader->canon->str, canon_len, tab->url[tab->redir[cur]]);
+    }
 
-        erase_url(&parsed_url);
-        if((*ret = parse_url(url, &parsed_url)) != SUCCESS) { //< Parsing of URL (with default scheme 'https://')
-            continue;
+    fwrite(out, sizeof(char), out_len, dst);
+    if(reader->transient) { //< Duplicates are fetched again instead of replaying the error (it may disappear)
+        free(out);
+    }
+    else {
+        cache_result(reader, tab, cur, canon_len, ret, out, out_len);
+    }
+
+    return ret;
+}
+
+
+/**
+ * @brief Initializes resources of reader
+ */
+int reader_init(reader_t *reader, settings_t *settings) {
+    init_url(&(reader->parsed_url));
+    seg_buff_init(&(reader->data_buff));
+    init_h_resp(&(reader->parsed_resp));
+    url_cache_init(&(reader->cache));
+    redir_memo_init(&(reader->memo), settings->redir_file);
+    reader->parser.ctxt = NULL;
+    reader->canon = NULL;
+    reader->transient = false;
+
+    int ret = net_init(&(reader->net), settings);
+    if(ret != SUCCESS) {
+        return ret;
+    }
+
+    reader->canon = new_string(INIT_STRING_SIZE);
+    if(!reader->canon) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro zpracovani URL!");
+        return INTERNAL_ERROR;
+    }
+
+    return feed_parser_init(&(reader->parser));
+}
+
+
+/**
+ * @brief Prints statistics of hedged requests to stderr (if hedging is enabled)
+ */
+void print_hedge_stats(reader_t *reader, settings_t *settings) {
+    if(!settings->hedge_flag) {
+        return;
+    }
+
+    hedge_t *hedge = &(reader->net.hedge);
+    fprintf(stderr, "%s: Zajistovaci pozadavky: odeslano %zu, rychlejsi nez puvodni %zu, usetreno alespon %.3f s\n",
+        PROGNAME, hedge->sent, hedge->won, hedge->saved_ms/1000.0);
+}
+
+
+/**
+ * @brief Frees all resources of reader
+ */
+void reader_dtor(reader_t *reader) {
+    if(reader->canon) {
+        string_dtor(reader->canon);
+    }
+
+    url_cache_dtor(&(reader->cache));
+    redir_memo_save(&(reader->memo)); //< Failure is only reported (results of sources were already printed)
+    redir_memo_dtor(&(reader->memo));
+    net_dtor(&(reader->net));
+    feed_parser_dtor(&(reader->parser));
+    seg_buff_dtor(&(reader->data_buff));
+    url_dtor(&(reader->parsed_url));
+}
+
+
+/**
+ * @brief Reads URL from the table and all its redirections (formatted feeds
+ * are written to dst)
+ *
+ * @return size_t Index of URL, that failed due to transient error (or URL_TAB_NONE)
+ */
+size_t read_chain(url_tab_t *url_tab, size_t orig, reader_t *reader, settings_t *settings, FILE *dst) {
+    settings->feed_deadline = deadline_after(settings->timeouts[TO_FEED]); //< Redirections are included in the time of the source
+
+    for(size_t cur = orig; cur != URL_TAB_NONE; cur = url_tab->redir[cur]) { //< Follow the chain of redirections
+        int ret = read_url(url_tab, cur, reader, settings, dst);
+        url_tab->result[cur] = ret; //< Table could be reallocated, so the result is stored after processing
+        if(reader->transient) {
+            return cur;
         }
+    }
 
-        *ret = load_data(&parsed_url, data_buff, url, settings); //< Loading data (XML doc)
-        if(*ret != SUCCESS) {
-            continue;
+    return URL_TAB_NONE;
+}
+
+
+void retry_queue_init(retry_queue_t *queue) {
+    queue->items = NULL;
+    queue->num = 0;
+    queue->cap = 0;
+    queue->seed = (unsigned int)(mono_ms() ^ (uint64_t)getpid());
+}
+
+
+void retry_queue_dtor(retry_queue_t *queue) {
+    free(queue->items);
+    queue->items = NULL;
+    queue->num = 0;
+    queue->cap = 0;
+}
+
+
+/**
+ * @brief Schedules repeated attempt to read URL after exponential backoff with
+ * jitter (the delay is random from the upper half of the backoff, so attempts
+ * to one server are spread)
+ *
+ * @param src Index of the original URL (source) of the failed URL
+ * @param failed Index of the failed URL (nothing is scheduled for URL_TAB_NONE)
+ * @param attempt Number of the scheduled attempt
+ * @param breaker Circuit breaker (URLs of hosts with open circuit are not repeated)
+ * @return true if the attempt was scheduled
+ */
+bool retry_schedule(retry_queue_t *queue, url_tab_t *url_tab, size_t src, size_t failed, long attempt, settings_t *settings, breaker_t *breaker) {
+    if(failed == URL_TAB_NONE || attempt > settings->retries) { //< The last result is kept
+        return false;
+    }
+
+    char host[MAX_HOST_LEN + 1], port[MAX_PORT_LEN + 1];
+    if(url_authority(url_tab->url[failed], host, port) != UNKNOWN && breaker_is_open(breaker, host, port)) {
+        return false;
+    }
+
+    uint64_t backoff = RETRY_BASE_DELAY_MS;
+    for(long i = 1; i < attempt && backoff < RETRY_MAX_DELAY_MS; i++) {
+        backoff *= 2;
+    }
+
+    backoff = backoff < RETRY_MAX_DELAY_MS ? backoff : RETRY_MAX_DELAY_MS;
+    uint64_t delay = backoff/2 + (uint64_t)rand_r(&(queue->seed)) % (backoff/2 + 1);
+    uint64_t due = mono_ms() + delay;
+    if(settings->run_deadline && due >= settings->run_deadline) { //< Attempt could not be performed anyway
+        return false;
+    }
+
+    if(queue->num == queue->cap) {
+        size_t new_cap = queue->cap ? queue->cap*2 : PREFETCH_WINDOW;
+        retry_t *new_items = (retry_t *)realloc(queue->items, new_cap*sizeof(retry_t));
+        if(!new_items) {
+            return false;
         }
 
-        data_ctx_t ctx = { .url = url, .parsed_url = &parsed_url };
-        *ret = parse_data(&ctx, current, data_buff);
-        if(*ret == HTTP_REDIRECT) {
-            *ret = SUCCESS;
-            continue;
+        queue->items = new_items;
+        queue->cap = new_cap;
+    }
+
+    queue->items[queue->num++] = (retry_t){ .idx = failed, .src = src, .attempt = attempt, .due = due };
+
+    printw("Zdroj '%s' bude znovu nacten za %" PRIu64 " ms (%ld. opakovani z %ld)", url_tab->url[failed], delay, attempt, settings->retries);
+
+    return true;
+}
+
+
+/**
+ * @brief Returns output of the source with given sequence number
+ */
+src_out_t *out_queue_item(out_queue_t *queue, size_t src) {
+    return &(queue->items[src % PREFETCH_WINDOW]);
+}
+
+
+/**
+ * @brief Performs scheduled attempts, that are due (failed attempts are scheduled again)
+ *
+ * @param outs Outputs of sources (output of source is completed when no more attempts are scheduled)
+ * @param wait If it is true, it waits for all attempts (until the run deadline)
+ */
+void run_retries(retry_queue_t *queue, url_tab_t *url_tab, reader_t *reader, settings_t *settings, out_queue_t *outs, bool wait) {
+    while(queue->num > 0) {
+        size_t next = 0;
+        for(size_t i = 1; i < queue->num; i++) {
+            if(queue->items[i].due < queue->items[next].due) {
+                next = i;
+            }
         }
-        else if(*ret != SUCCESS) {
-            continue;
+
+        retry_t retry = queue->items[next];
+        uint64_t now = mono_ms();
+        if(retry.due > now) {
+            if(!wait) {
+                return;
+            }
+
+            poll(NULL, 0, (int)(retry.due - now));
+        }
+
+        if(ms_left(settings->run_deadline) == 0) { //< Remaining attempts are dropped, URLs keep their last result
+            queue->num = 0;
+            return;
+        }
+
+        queue->items[next] = queue->items[--queue->num];
+
+        src_out_t *src_out = out_queue_item(outs, retry.src);
+        size_t failed = read_chain(url_tab, retry.idx, reader, settings, src_out->stream);
+        src_out->done = !retry_schedule(queue, url_tab, retry.src, failed, retry.attempt + 1, settings, &(reader->net.breaker));
+    }
+}
+
+
+/**
+ * @brief Returns time in ms until the nearest scheduled attempt (-1 if there is no attempt)
+ */
+int retry_wait_ms(retry_queue_t *queue) {
+    if(queue->num == 0) {
+        return -1;
+    }
+
+    uint64_t due = queue->items[0].due, now = mono_ms();
+    for(size_t i = 1; i < queue->num; i++) {
+        due = queue->items[i].due < due ? queue->items[i].due : due;
+    }
+
+    return due > now ? (int)(due - now) : 0;
+}
+
+
+/**
+ * @brief Initializes empty queue of outputs
+ */
+void out_queue_init(out_queue_t *queue) {
+    queue->num = 0;
+    queue->next_out = 0;
+}
+
+
+/**
+ * @brief Checks whether all outputs are held (the next source cannot be opened)
+ */
+bool out_queue_full(out_queue_t *queue) {
+    return queue->num - queue->next_out == PREFETCH_WINDOW;
+}
+
+
+/**
+ * @brief Opens output of the next source (its sequence number is the amount
+ * of already opened outputs), the queue must not be full
+ *
+ * @return FILE* Stream for output of the source
+ */
+FILE *out_queue_open(out_queue_t *queue) {
+    src_out_t *item = out_queue_item(queue, queue->num++);
+    item->out = NULL;
+    item->out_len = 0;
+    item->done = false;
+
+    item->stream = open_memstream(&(item->out), &(item->out_len));
+    if(!item->stream) { //< Output is printed directly (it is out of order only if some previous source is retried)
+        item->stream = stdout;
+    }
+
+    return item->stream;
+}
+
+
+/**
+ * @brief Prints outputs of finished sources in the order of the table (until
+ * the first source, that is still retried)
+ */
+void out_queue_flush(out_queue_t *queue) {
+    while(queue->next_out < queue->num && out_queue_item(queue, queue->next_out)->done) {
+        src_out_t *item = out_queue_item(queue, queue->next_out);
+        if(item->stream != stdout) {
+            fclose(item->stream);
+            fwrite(item->out, sizeof(char), item->out_len, stdout);
+            free(item->out);
         }
 
-        *ret = parse_and_print(ctx.doc_start, ctx.exp_type, settings, url);
+        queue->next_out++;
     }
 
-    string_dtor(data_buff);
-    url_dtor(&parsed_url);
+    fflush(stdout); //< Output of the feed is visible immediately (even if stdout is pipe)
+}
+
+
+/**
+ * @brief Prints all outputs (remaining attempts were dropped) and resets the queue
+ */
+void out_queue_finish(out_queue_t *queue) {
+    for(size_t i = queue->next_out; i < queue->num; i++) {
+        out_queue_item(queue, i)->done = true;
+    }
+
+    out_queue_flush(queue);
+    out_queue_init(queue);
+}
+
+
+/**
+ * @brief Performs the general functionality of the program - parsing and 
+ * printing formatted feed from all specified source
+ * 
+ * @param url_tab Table with URLs to feed documents 
+ * @param settings Settings of the program
+ * @return int SUCCESS if everything went OK, otherwise INTERNAL ERROR
+ * @note If problem occurs while parsing URL or XML from source, result column
+ * in URL table is modified, but processing of other URLs continues
+ */
+int do_feedread(url_tab_t *url_tab, settings_t *settings) {
+    reader_t reader;
+    int ret = reader_init(&reader, settings);
+    if(ret != SUCCESS) {
+        reader_dtor(&reader);
+        return ret;
+    }
+
+    openssl_init();
+
+    retry_queue_t retries;
+    retry_queue_init(&retries);
+
+    out_queue_t outs;
+    out_queue_init(&outs);
+
+    size_t orig_num = url_tab->num; //< Redirections are appended behind the original URLs
+    for(size_t i = 0; i < orig_num && i < PREFETCH_WINDOW; i++) { //< Parse URL, load document and parse it for every original URL in table (there is only URL from arguments)
+        FILE *out = out_queue_open(&outs);
+        size_t failed = read_chain(url_tab, i, &reader, settings, out);
+        out_queue_item(&outs, i)->done = !retry_schedule(&retries, url_tab, i, failed, 1, settings, &(reader.net.breaker));
+        run_retries(&retries, url_tab, &reader, settings, &outs, false);
+        out_queue_flush(&outs);
+    }
+
+    run_retries(&retries, url_tab, &reader, settings, &outs, true);
+    out_queue_finish(&outs);
+    retry_queue_dtor(&retries);
+
+    print_hedge_stats(&reader, settings);
+    reader_dtor(&reader);
 
     openssl_cleanup();
 
@@ -375,31 +903,20 @@ int do_feedread(list_t *url_list, settings_t *settings) {
 
 
 /**
- * @brief Creates linked list with URLs (it can be one element list or
- * llinked list with multiple element in case of using feedfile -
- * feedfile has higher precedence than single URL)
+ * @brief Fills table with single URL from arguments of the program
  * 
- * @param url_list Output structure with URLs
+ * @param url_tab Output table with URLs
  * @param settings Settings of the program
  * @return int SUCCESS if everything went ok
  */
-int create_url_list(list_t *url_list, settings_t *settings) {
+int create_url_tab(url_tab_t *url_tab, settings_t *settings) {
     int ret_code = SUCCESS;
 
-    if(settings->feedfile) { //< Feed file was specified so sandalone URL in argument is ignored
-        ret_code = parse_feedfile(settings->feedfile, url_list);
-    }
-    else if(settings->url) { //< Put URL from argument to the liast as one element
-        list_el_t *first = new_element(settings->url);
-        if(!first) {
-            printerr(INTERNAL_ERROR, "Nepodarilo se vytvorit novy element pro seznam URL adres!");
+    if(settings->url) { //< Put URL from argument to the table as the only one entry
+        if(url_tab_append(url_tab, settings->url, strlen(settings->url), 0) == URL_TAB_NONE) {
+            printerr(INTERNAL_ERROR, "Nepodarilo se vytvorit novy zaznam v tabulce URL adres!");
             ret_code = INTERNAL_ERROR;
         }
-        else {
-            first->result = SUCCESS;
-            first->indirect_lvl = 0; //< It is original URL
-            list_append(url_list, first);
-        }
     }
 
     return ret_code;
@@ -407,22 +924,496 @@ int create_url_list(list_t *url_list, settings_t *settings) {
 
 
 /**
- * @brief Returns first non-SUCCESS return code from chain of processed URLs 
+ * @brief Returns first non-SUCCESS return code from chains of processed URLs 
+ */
+int get_return_code(url_tab_t *url_tab) {
+    for(size_t i = 0; i < url_tab->num; i++) {
+        if(url_tab->indirect_lvl[i] > 0) {
+            continue;
+        }
+
+        for(size_t cur = i; cur != URL_TAB_NONE; cur = url_tab->redir[cur]) { //< The same order as in do_feedread
+            if(url_tab->result[cur] != SUCCESS) {
+                return url_tab->result[cur];
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Reads the next window of URLs from feedfile (behind URLs, that were
+ * already processed) and starts resolution of their hosts in background
+ * @note The first URL is waited for (at most wait_ms, -1 means no limit), the
+ * next ones are taken only if they are already read (so URLs from pipes are not delayed)
+ *
+ * @param next Index of the first URL in the table, that was not processed yet
+ */
+int fill_window(feedfile_t *src, url_tab_t *url_tab, size_t next, int wait_ms, resolver_t *resolver) {
+    char host[MAX_HOST_LEN + 1], port[MAX_PORT_LEN + 1];
+    int ret = SUCCESS;
+
+    while(url_tab->num - next < PREFETCH_WINDOW) {
+        size_t prev_num = url_tab->num;
+        if((ret = feedfile_next(src, url_tab, prev_num == next ? wait_ms : 0)) != SUCCESS || url_tab->num == prev_num) {
+            break;
+        }
+
+        if(url_authority(url_tab->url[prev_num], host, port) != UNKNOWN) {
+            resolver_prefetch(resolver, host, port);
+        }
+    }
+
+    return ret;
+}
+
+
+/**
+ * @brief Requests connections in advance to distinct hosts of URLs following
+ * the current one (until all slots of pre-connector are used)
+ * 
+ * @param url_tab Table with URLs of the current window
+ * @param next Index of the first following URL
+ * @param num Amount of original URLs in the window
+ * @param net Network resources with pre-connector (hosts with open circuit are not connected)
+ */
+void request_preconns(url_tab_t *url_tab, size_t next, size_t num, net_t *net) {
+    char host[MAX_HOST_LEN + 1], port[MAX_PORT_LEN + 1];
+
+    for(size_t i = next; i < num && i < next + PRECONN_LOOKAHEAD; i++) {
+        src_type_t type = url_authority(url_tab->url[i], host, port);
+        if(type == UNKNOWN || breaker_is_open(&(net->breaker), host, port)) {
+            continue;
+        }
+
+        if(!preconn_request(&(net->preconn), type == HTTPS_SRC, host, port, NULL)) {
+            break; //< There is no free slot
+        }
+    }
+}
+
+
+/**
+ * @brief Reads URLs from feedfile (or stdin) and processes each of them right 
+ * after its line is read, so the output is produced before the whole feedfile
+ * is read and only URLs of the current window are kept in memory
+ * 
+ * @param path Path to the feedfile ("-" for standard input)
+ * @param settings Settings of the program
+ * @return int First non-SUCCESS return code or SUCCESS
  */
-int get_return_code(list_t *url_list) {
+int do_stream_feedread(char *path, settings_t *settings) {
+    feedfile_t src;
+    int ret = feedfile_open(&src, path);
+    if(ret != SUCCESS) {
+        return ret;
+    }
+
+    reader_t reader;
+    if((ret = reader_init(&reader, settings)) != SUCCESS) {
+        reader_dtor(&reader);
+        feedfile_close(&src);
+        return ret;
+    }
+
+    openssl_init();
+
+    url_tab_t url_tab;
+    url_tab_init(&url_tab);
+
+    retry_queue_t retries;
+    retry_queue_init(&retries);
+
+    out_queue_t outs;
+    out_queue_init(&outs);
+
     int ret_code = SUCCESS;
-    list_el_t *url = url_list->header;
+    bool expired = false;
+    size_t next = 0; //< Index of the first URL in the table, that was not processed yet
+    while(!expired && (ret = fill_window(&src, &url_tab, next, retry_wait_ms(&retries), &(reader.net.resolver))) == SUCCESS) {
+        size_t num = url_tab.num; //< Redirections are appended behind the processed URLs
+        for(; next < num; next++) {
+            if(url_tab.indirect_lvl[next] > 0) { //< Redirection of the source from the previous window
+                continue;
+            }
+
+            if((expired = ms_left(settings->run_deadline) == 0)) { //< The rest of sources is skipped
+                break;
+            }
+
+            if(out_queue_full(&outs)) { //< Outputs of all held sources are kept, so the next source must wait for attempts
+                run_retries(&retries, &url_tab, &reader, settings, &outs, true);
+                out_queue_flush(&outs);
+            }
+
+            request_preconns(&url_tab, next + 1, num, &(reader.net)); //< Connecting to the next hosts overlaps with processing of the current URL
+            size_t seq = outs.num;
+            FILE *out = out_queue_open(&outs);
+            size_t failed = read_chain(&url_tab, next, &reader, settings, out);
+            out_queue_item(&outs, seq)->done = !retry_schedule(&retries, &url_tab, seq, failed, 1, settings, &(reader.net.breaker));
+            run_retries(&retries, &url_tab, &reader, settings, &outs, false); //< Attempts, whose backoff elapsed, are performed between other URLs
+            out_queue_flush(&outs); //< Outputs of sources are printed in the order of feedfile
+        }
+
+        if(expired) {
+            break;
+        }
+
+        next = url_tab.num; //< Only redirections were appended behind the processed sources
+        run_retries(&retries, &url_tab, &reader, settings, &outs, false); //< Waiting for the next line could be interrupted by due attempt
+        out_queue_flush(&outs);
+
+        bool is_read = feedfile_is_read(&src);
+        if(is_read || url_tab.num >= MAX_HELD_TAB_SIZE) { //< Table can be reset only after the remaining attempts
+            run_retries(&retries, &url_tab, &reader, settings, &outs, true);
+        }
+
+        if(retries.num == 0) { //< Table is reset, when no attempt refers to it
+            out_queue_finish(&outs);
+            if(ret_code == SUCCESS) {
+                ret_code = get_return_code(&url_tab);
+            }
+
+            url_tab_reset(&url_tab);
+            next = 0;
+        }
 
-    while(url) {
-        if(url->result != SUCCESS) {
-            ret_code = url->result;
+        if(is_read) {
             break;
         }
+    }
 
-        url = url->next;
+    retries.num = 0; //< Remaining attempts are dropped, URLs keep their last result
+    out_queue_finish(&outs);
+    if(ret_code == SUCCESS) {
+        ret_code = get_return_code(&url_tab);
     }
 
-    return ret_code;
+    if(expired) {
+        printerr(COMMUNICATION_ERROR, "Vyprsel cas behu programu, zbyvajici zdroje nebyly zpracovany!");
+        ret_code = ret_code == SUCCESS ? COMMUNICATION_ERROR : ret_code;
+    }
+
+    print_hedge_stats(&reader, settings);
+    retry_queue_dtor(&retries);
+    url_tab_dtor(&url_tab);
+    reader_dtor(&reader);
+    feedfile_close(&src);
+
+    openssl_cleanup();
+
+    return ret != SUCCESS ? ret : ret_code;
+}
+
+
+/**
+ * @brief Finds local feed files given by path to the directory (all files
+ * inside it) or by glob pattern
+ * 
+ * @param src Path to the directory or glob pattern
+ * @param files Output structure with found paths (sorted, so the order is deterministic)
+ * @return int SUCCESS if there is at least one matching path
+ */
+int find_feed_files(char *src, glob_t *files) {
+    char pattern[FILENAME_MAX];
+    struct stat src_stat;
+
+    if(!stat(src, &src_stat) && S_ISDIR(src_stat.st_mode)) { //< Directory -> all (not hidden) files inside it
+        size_t len = strlen(src);
+        bool has_slash = len > 0 && src[len - 1] == '/';
+        if(snprintf(pattern, FILENAME_MAX, "%s%s*", src, has_slash ? "" : "/") >= FILENAME_MAX) {
+            printerr(FILE_ERROR, "Prilis dlouha cesta ke slozce '%s'!", src);
+            return FILE_ERROR;
+        }
+    }
+    else if(snprintf(pattern, FILENAME_MAX, "%s", src) >= FILENAME_MAX) { //< It is considered as glob pattern
+        printerr(FILE_ERROR, "Prilis dlouhy vzor '%s'!", src);
+        return FILE_ERROR;
+    }
+
+    int ret = glob(pattern, 0, NULL, files);
+    if(ret == GLOB_NOSPACE) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro seznam souboru z '%s'!", src);
+        return INTERNAL_ERROR;
+    }
+    else if(ret != 0) {
+        printerr(FILE_ERROR, "Nebyly nalezeny zadne soubory odpovidajici '%s'!", src);
+        return FILE_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Prints outputs of finished documents, that are next in the order
+ * (lock of batch must be held by the caller)
+ */
+void batch_flush(batch_t *batch) {
+    while(batch->next_out < batch->num && batch->res[batch->next_out].done) {
+        batch_res_t *res = &(batch->res[batch->next_out]);
+        if(res->out) {
+            fwrite(res->out, sizeof(char), res->out_len, stdout);
+            free(res->out);
+            res->out = NULL;
+        }
+
+        batch->next_out++;
+    }
+}
+
+
+/**
+ * @brief Parses loaded document of one local feed file and prints the result 
+ * to the memory stream 
+ */
+int batch_parse_doc(batch_t *batch, size_t i, char *doc, size_t doc_len, feed_parser_t *parser) {
+    batch_res_t *res = &(batch->res[i]);
+    char *path = batch->paths[i];
+
+    res->bytes = doc_len;
+
+    FILE *out = open_memstream(&(res->out), &(res->out_len)); //< Output is printed later (in the order of files)
+    if(!out) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro vystup z '%s'!", path);
+        return INTERNAL_ERROR;
+    }
+
+    int ret = parse_and_print(doc, doc_len, XML, NULL, batch->settings, path, parser, out);
+    fclose(out);
+
+    return ret;
+}
+
+
+/**
+ * @brief Loads one local feed file by ordinary syscalls, parses it and prints 
+ * the result to the memory stream 
+ */
+int batch_parse_file(batch_t *batch, size_t i, seg_buff_t *data_buff, feed_parser_t *parser) {
+    char *path = batch->paths[i];
+
+    seg_buff_reset(data_buff);
+    int ret = load_file(path, data_buff);
+    if(ret != SUCCESS) {
+        return ret;
+    }
+
+    size_t doc_len;
+    char *doc = seg_flatten(data_buff, 0, &doc_len);
+    if(!doc) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro data z '%s'!", path);
+        return INTERNAL_ERROR;
+    }
+
+    return batch_parse_doc(batch, i, doc, doc_len, parser);
+}
+
+
+/**
+ * @brief Parses local feed file, that was already loaded by io_uring
+ */
+int batch_parse_loaded(batch_t *batch, size_t i, uring_file_t *file, feed_parser_t *parser) {
+    if(file->err) {
+        printerr(FILE_ERROR, "Nepodarilo se otevrit soubor '%s'! (%s)", file->path, strerror(file->err));
+        return FILE_ERROR;
+    }
+
+    #ifdef DEBUG
+        fprintf(stderr, "File content (%ld B) from '%s' (io_uring)\n\n", file->len, file->path);
+    #endif
+
+    return batch_parse_doc(batch, i, file->data, file->len, parser);
+}
+
+
+/**
+ * @brief Takes the next files from the batch (more files are taken at once if 
+ * io_uring is used, but there must be enough files for other workers)
+ * 
+ * @return size_t Amount of taken files (0 if there are no unprocessed files)
+ */
+size_t batch_take(batch_t *batch, bool use_uring, size_t *first) {
+    pthread_mutex_lock(&(batch->lock));
+
+    size_t left = batch->next < batch->num ? batch->num - batch->next : 0;
+    size_t num = use_uring ? left/batch->worker_num : 1;
+    num = num > URING_BATCH_SIZE ? URING_BATCH_SIZE : num;
+    num = num < 1 ? 1 : num;
+    num = num > left ? left : num;
+
+    *first = batch->next;
+    batch->next += num;
+
+    pthread_mutex_unlock(&(batch->lock));
+
+    return num;
+}
+
+
+/**
+ * @brief Worker, that parses files from the batch until there is any unprocessed file
+ */
+void *batch_worker(void *arg) {
+    batch_t *batch = (batch_t *)arg;
+
+    seg_buff_t data_buff;
+    seg_buff_init(&data_buff);
+
+    uring_t ring;
+    uring_file_t files[URING_BATCH_SIZE];
+    memset(files, 0, sizeof(files));
+    bool use_uring = uring_init(&ring, 2*URING_BATCH_SIZE); //< If io_uring is not available, ordinary syscalls are used
+
+    feed_parser_t parser;
+    int parser_ret = feed_parser_init(&parser);
+
+    size_t first, num;
+    while((num = batch_take(batch, use_uring, &first)) > 0) {
+        if(use_uring) {
+            for(size_t j = 0; j < num; j++) {
+                files[j].path = batch->paths[first + j];
+            }
+
+            if(!uring_load_files(&ring, files, num)) { //< Fallback to ordinary syscalls
+                uring_dtor(&ring);
+                use_uring = false;
+            }
+        }
+
+        for(size_t j = 0; j < num; j++) {
+            size_t i = first + j;
+
+            int ret = parser_ret;
+            if(ret == SUCCESS) {
+                ret = use_uring ? batch_parse_loaded(batch, i, &(files[j]), &parser) : 
+                                  batch_parse_file(batch, i, &data_buff, &parser);
+            }
+
+            pthread_mutex_lock(&(batch->lock));
+            batch->res[i].ret = ret;
+            batch->res[i].done = true;
+            batch_flush(batch); //< Print all documents, that are ready to be printed
+            pthread_mutex_unlock(&(batch->lock));
+        }
+    }
+
+    if(parser_ret == SUCCESS) {
+        feed_parser_dtor(&parser);
+    }
+
+    if(use_uring) {
+        uring_dtor(&ring);
+    }
+
+    uring_files_dtor(files, URING_BATCH_SIZE);
+    seg_buff_dtor(&data_buff);
+
+    return NULL;
+}
+
+
+/**
+ * @brief Returns the amount of workers for parsing of given amount of files
+ */
+size_t get_worker_num(size_t file_num) {
+    long cpu_num = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t worker_num = cpu_num > 0 ? (size_t)cpu_num : 1;
+    if(worker_num > MAX_WORKER_NUM) {
+        worker_num = MAX_WORKER_NUM;
+    }
+
+    return worker_num < file_num ? worker_num : file_num;
+}
+
+
+/**
+ * @brief Parses all local feed files from directory (or given by glob 
+ * pattern) in parallel and prints them in deterministic order (sorted by path)
+ * 
+ * @param settings Settings of the program
+ * @return int First non-SUCCESS result of files (in their order) or SUCCESS
+ */
+int do_batch_feedread(settings_t *settings) {
+    glob_t files;
+    int ret = find_feed_files(settings->feeddir, &files);
+    if(ret != SUCCESS) {
+        globfree(&files);
+        return ret;
+    }
+
+    batch_t batch = { .settings = settings };
+    batch.paths = (char **)malloc(files.gl_pathc*sizeof(char *));
+    batch.res = (batch_res_t *)calloc(files.gl_pathc, sizeof(batch_res_t));
+    if(!batch.paths || !batch.res) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro vysledky zpracovani souboru!");
+        free(batch.paths);
+        free(batch.res);
+        globfree(&files);
+        return INTERNAL_ERROR;
+    }
+
+    for(size_t i = 0; i < files.gl_pathc; i++) { //< Only regular files (or links to them) are processed
+        struct stat file_stat;
+        if(!stat(files.gl_pathv[i], &file_stat) && S_ISREG(file_stat.st_mode)) {
+            batch.paths[batch.num++] = files.gl_pathv[i];
+        }
+    }
+
+    if(batch.num == 0) {
+        printerr(FILE_ERROR, "Nebyly nalezeny zadne soubory odpovidajici '%s'!", settings->feeddir);
+        free(batch.paths);
+        free(batch.res);
+        globfree(&files);
+        return FILE_ERROR;
+    }
+
+    pthread_mutex_init(&(batch.lock), NULL);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_t workers[MAX_WORKER_NUM];
+    size_t started = 0;
+    batch.worker_num = get_worker_num(batch.num);
+    for(; started < batch.worker_num; started++) {
+        if(pthread_create(&(workers[started]), NULL, batch_worker, &batch)) {
+            break; //< Files are processed by already running workers
+        }
+    }
+
+    if(started == 0) { //< There are no workers, so files are processed by this thread
+        batch.worker_num = 1;
+        batch_worker(&batch);
+    }
+
+    for(size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)/1e9;
+
+    size_t total_bytes = 0;
+    for(size_t i = 0; i < batch.num; i++) {
+        total_bytes += batch.res[i].bytes;
+        if(ret == SUCCESS && batch.res[i].ret != SUCCESS) { //< Get first invalid return code (if there is any)
+            ret = batch.res[i].ret;
+        }
+    }
+
+    fflush(stdout);
+    fprintf(stderr, "%s: Zpracovano %zu souboru (%.2f MB) za %.3f s pomoci %zu vlaken (%.2f MB/s)\n", 
+        PROGNAME, batch.num, total_bytes/1e6, elapsed, started ? started : 1, elapsed > 0 ? total_bytes/1e6/elapsed : 0.0);
+
+    pthread_mutex_destroy(&(batch.lock));
+    free(batch.paths);
+    free(batch.res);
+    globfree(&files);
+
+    return ret;
 }
 
 
@@ -449,25 +1440,42 @@ int main(int argc, char **argv) {
         return ret_code;
     }
 
-    list_t url_list;
-    list_init(&url_list);
+    settings.run_deadline = deadline_after(settings.timeouts[TO_RUN]);
+
+    if(settings.feeddir) { //< Local files are processed without URL table
+        xml_parser_init();
+        ret_code = do_batch_feedread(&settings);
+        xml_parser_cleanup();
+
+        return ret_code;
+    }
+    else if(settings.feedfile) { //< URLs from feedfile are processed while it is read
+        xml_parser_init();
+        ret_code = do_stream_feedread(settings.feedfile, &settings);
+        xml_parser_cleanup();
+
+        return ret_code;
+    }
+
+    url_tab_t url_tab;
+    url_tab_init(&url_tab);
 
-    if((ret_code = create_url_list(&url_list, &settings)) != SUCCESS) {
-        list_dtor(&url_list);
+    if((ret_code = create_url_tab(&url_tab, &settings)) != SUCCESS) {
+        url_tab_dtor(&url_tab);
         return ret_code;
     }
 
     //Main procedure
     xml_parser_init();
-    ret_code = do_feedread(&url_list, &settings);
+    ret_code = do_feedread(&url_tab, &settings);
     xml_parser_cleanup();
 
     //Get first invalid return code (if there is any)
     if(ret_code == SUCCESS) {
-        ret_code = get_return_code(&url_list);
+        ret_code = get_return_code(&url_tab);
     }
 
-    list_dtor(&url_list);
+    url_tab_dtor(&url_tab);
 
     return ret_code;
 }
\ No newline at end of file
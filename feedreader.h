@@ -9,10 +9,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <errno.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <glob.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <sys/stat.h>
 
 
 #include "common.h"
@@ -20,6 +27,8 @@
 #include "http.h"
 #include "feed.h"
 #include "url.h"
+#include "uring.h"
+#include "redir.h"
 
 
 /**
@@ -28,9 +37,131 @@
  */
 typedef struct data_ctx {
     char* doc_start; //< Ptr to start of the document with feed
+    size_t doc_len; //< Exact length of the document (it can contain null bytes, e. g. in UTF-16)
     int exp_type; //< Expected type of document
+    char *encoding; //< Encoding of the document declared by its source (or NULL)
     url_t *parsed_url; //< Analysed URL
     char *url; //< Original URL
 } data_ctx_t;
 
 
+#define MAX_CACHED_OUT_SIZE (64*1024*1024) //< Maximum total size of cached outputs (results of next URLs are not cached)
+
+
+/**
+ * @brief Resources, that are reused for reading of all URLs (by one worker)
+ */
+typedef struct reader {
+    url_t parsed_url; //< Analysed URL
+    seg_buff_t data_buff; //< Buffer for loaded data (segments are recycled for every URL)
+    h_resp_t parsed_resp; //< Analysed HTTP response
+    feed_parser_t parser; //< Parser of XML documents
+    string_t *canon; //< Buffer for canonical form of the current URL
+    url_cache_t cache; //< Results of already processed URLs (each resource is fetched only once)
+    net_t net; //< Resolver, pre-connector and latencies of hosts
+    redir_memo_t memo; //< Permanent redirections remembered across runs
+    bool transient; //< Flag signalizing, that the last read URL failed due to transient error (it may be read again)
+} reader_t;
+
+
+#define RETRY_BASE_DELAY_MS 250 //< Delay before the first repeated attempt (it is doubled for each next attempt)
+#define RETRY_MAX_DELAY_MS 4000 //< Upper bound of delay before repeated attempt
+
+
+/**
+ * @brief Repeated attempt to read URL, that failed due to transient error
+ */
+typedef struct retry {
+    size_t idx; //< Index of the failed URL in the table
+    size_t src; //< Sequence number of the source in the queue of outputs (its output is extended by the attempt)
+    long attempt; //< Number of the attempt (starting from 1)
+    uint64_t due; //< Time (in ms of monotonic clock), when the attempt should be performed
+} retry_t;
+
+
+/**
+ * @brief Queue with deferred attempts (URLs are read again after backoff,
+ * while other URLs are processed)
+ */
+typedef struct retry_queue {
+    retry_t *items; //< Scheduled attempts (unordered)
+    size_t num; //< Amount of scheduled attempts
+    size_t cap; //< Capacity of the array
+    unsigned int seed; //< State of random generator for jitter
+} retry_queue_t;
+
+
+#define FEEDFILE_CHUNK_SIZE 65536 //< Maximum amount of bytes, that are read from feedfile at once
+#define FEEDFILE_STDIN "-" //< Path to the feedfile, that means standard input
+#define PREFETCH_WINDOW 64 //< Maximum amount of URLs from feedfile, whose hosts are resolved in advance
+#define PRECONN_LOOKAHEAD (4*PRECONN_NUM) //< Maximum amount of following URLs, that are searched for hosts to be connected in advance
+#define MAX_HELD_TAB_SIZE (4*PREFETCH_WINDOW) //< Size of the table with URLs, after which remaining attempts are waited for (so the table can be reset)
+
+
+/**
+ * @brief Output of one source (it is printed after outputs of all previous sources)
+ */
+typedef struct src_out {
+    char *out; //< Formatted output of all attempts of the source
+    size_t out_len; //< Length of the output
+    FILE *stream; //< Memory stream writing to out (or stdout if it could not be opened)
+    bool done; //< Flag signalizing, that no more attempts of the source are scheduled
+} src_out_t;
+
+
+/**
+ * @brief Outputs of sources, that are not printed yet (sources retried later
+ * are printed still in the order of feedfile)
+ */
+typedef struct out_queue {
+    src_out_t items[PREFETCH_WINDOW]; //< Ring buffer with outputs (indexed by sequence numbers of sources)
+    size_t num; //< Amount of opened outputs (sequence number of the next source)
+    size_t next_out; //< Sequence number of the next output, that should be printed
+} out_queue_t;
+
+
+/**
+ * @brief Feedfile, that is read by chunks (URLs are processed right after their line is read)
+ */
+typedef struct feedfile {
+    char *path; //< Path to the feedfile (for error messages)
+    int fd; //< Descriptor of feedfile (or standard input)
+    char chunk[FEEDFILE_CHUNK_SIZE]; //< Last read chunk
+    size_t pos, end; //< Unprocessed part of the chunk
+    string_t *line; //< Buffer with the currently processed line
+    size_t len; //< Length of the currently processed line
+    bool is_cmnt; //< Flag signalizing, that current line is a comment
+    bool eof; //< Flag signalizing, that the whole feedfile was read
+} feedfile_t;
+
+
+#define MAX_WORKER_NUM 64 //< Maximum amount of threads, that parse local files in parallel
+
+
+/**
+ * @brief Result of processing of one local feed file in batch mode
+ */
+typedef struct batch_res {
+    char *out; //< Formatted output (it is printed after all previous files are printed)
+    size_t out_len; //< Length of the output
+    size_t bytes; //< Size of the processed document
+    int ret; //< Result code
+    bool done; //< Flag signalizing, that file was already processed
+} batch_res_t;
+
+
+/**
+ * @brief Shared state of workers, that parse local feed files in parallel
+ */
+typedef struct batch {
+    char **paths; //< Paths to the files (sorted)
+    size_t num; //< Amount of files
+    size_t next; //< Index of the next file, that should be processed
+    size_t next_out; //< Index of the next file, that should be printed
+    size_t worker_num; //< Amount of workers (it limits the amount of files taken at once)
+    batch_res_t *res; //< Results of files (in the same order as paths)
+    settings_t *settings; //< Settings of the program
+    pthread_mutex_t lock; //< Lock for all indexes and results
+} batch_t;
+
+
@@ -18,6 +18,15 @@
 # If OUPUT_FILE_NAME or RET_CODE_FILE_NAME is missing, there is no comparison
 # of expected return code or output (depends on missing file)
 #
+# Files written by the program (e. g. state files) are prepared from fixtures:
+# every *FIXTURE_IN_SUFFIX file is copied to *.tmp before the run (arguments
+# refer to the copy) and if there is *FIXTURE_OUT_SUFFIX file with the same
+# name, it is compared with the copy after the run
+#
+# If there is executable SERVER_FILE_NAME in test case folder (e. g. local HTTP
+# server), it is started before the run and stopped after it (the program is
+# run, when the server prints the first line to its stdout)
+#
 # For preserving output files (*.tmp) use -v option, otherwise thy are deleted
 # For running tests with valgrind use -m option (in this case is dependent on 
 # valgrind)
@@ -35,6 +44,13 @@ ERROR_FILE_NAME="err.tmp" # File with STDERR that was produced by the program
 DIFF_FILE_NAME="diff.tmp" # Differences between expected and real STDOUT
 VALGRIND_LOG_FILE_NAME="valgrind.tmp"
 
+FIXTURE_IN_SUFFIX=".in" # Fixture, that is copied to *.tmp before the run
+FIXTURE_OUT_SUFFIX=".out" # Expected content of *.tmp after the run
+
+SERVER_FILE_NAME="server" # Executable, that is running during the test
+SERVER_OUTPUT_FILE_NAME="server.tmp" # Output of the server
+SERVER_START_TRIES=50 # Amount of checks (every 0.1 s), whether the server is ready
+
 VERBOSE=0 # Default value of verbose
 MEMCHECK=0 # Default value of memcheck
 ALL_TESTS=0
@@ -155,6 +171,32 @@ function test_exec() {
                 PROGRAM_REALPATH=$(realpath ${PROGRAM_PATH})
                 cd $TEST # Go to Directory with current test
 
+                FIXTURES=""
+                for FIXTURE in *$FIXTURE_IN_SUFFIX
+                do
+                    if [ -f "$FIXTURE" ]
+                    then
+                        cp "$FIXTURE" "${FIXTURE%$FIXTURE_IN_SUFFIX}.tmp"
+                        FIXTURES="$FIXTURES ${FIXTURE%$FIXTURE_IN_SUFFIX}"
+                    fi
+                done
+
+                SERVER_PID=""
+                if [ -x "$SERVER_FILE_NAME" ]
+                then
+                    ./$SERVER_FILE_NAME >$SERVER_OUTPUT_FILE_NAME 2>&1 &
+                    SERVER_PID=$!
+                    for TRY in $(seq $SERVER_START_TRIES)
+                    do
+                        if [ -s "$SERVER_OUTPUT_FILE_NAME" ] || ! kill -0 $SERVER_PID 2>/dev/null
+                        then
+                            break
+                        fi
+
+                        sleep 0.1
+                    done
+                fi
+
                 if [ $MEMCHECK == 1 ] # Testing
                 then
                     eval "${VALGRIND_CMD} --leak-check=full --log-file=\"${VALGRIND_LOG_FILE_NAME}\" ${PROGRAM_REALPATH} >${RESULT_FILE} 2>${ERROR_FILE} ${ARGS}"
@@ -162,6 +204,12 @@ function test_exec() {
                     eval "${PROGRAM_REALPATH} >${RESULT_FILE} 2>${ERROR_FILE} ${ARGS}"
                 fi
                 RETURN_CODE=$?
+
+                if [ "$SERVER_PID" != "" ]
+                then
+                    kill $SERVER_PID 2>/dev/null
+                    wait $SERVER_PID 2>/dev/null
+                fi
                 
                 REASON=""
                 RESULT=$PASSED_MSG
@@ -185,6 +233,19 @@ function test_exec() {
                     fi
                 fi
 
+                for FIXTURE in $FIXTURES
+                do
+                    if [ -f "$FIXTURE$FIXTURE_OUT_SUFFIX" ]
+                    then
+                        diff "$FIXTURE.tmp" "$FIXTURE$FIXTURE_OUT_SUFFIX" >> $DIFF_FILE_NAME
+                        if [ $? != 0 ]
+                        then
+                            REASON="${REASON}Different content of '$FIXTURE.tmp'! (use -v to preserve it)\n"
+                            RESULT=$FAILED_MSG
+                        fi
+                    fi
+                done
+
                 if [ $MEMCHECK == 1 ]
                 then
                     VALGRIND_LOG_TAIL=`cat ${VALGRIND_LOG_FILE_NAME} | tail -1`
@@ -198,7 +259,11 @@ function test_exec() {
 
                 if [ $VERBOSE != 1 ] # Remove temporary files
                 then
-                    rm -f $ERROR_FILE $RESULT_FILE $DIFF_FILE_NAME $VALGRIND_LOG_FILE_NAME
+                    rm -f $ERROR_FILE $RESULT_FILE $DIFF_FILE_NAME $VALGRIND_LOG_FILE_NAME $SERVER_OUTPUT_FILE_NAME
+                    for FIXTURE in $FIXTURES
+                    do
+                        rm -f "$FIXTURE.tmp"
+                    done
                 fi
 
                 echo -e "$RESULT\t$DESCRIPTION"
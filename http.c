@@ -33,24 +33,27 @@ void openssl_cleanup() {
 }
 
 
-int send_request(BIO *bio, url_t *p_url, char *url) {
-    int ret, attempt_num = 0;
-
-    struct pollfd pfd;
-    pfd.fd = BIO_get_fd(bio, NULL);
-    pfd.events = POLLIN;
+/**
+ * @brief Writes HTTP request for the given URL to BIO (no messages are printed),
+ * its bytes are accounted by the limiter
+ *
+ * @return int 1 if request was sent, 0 if the server was idle for too long, -1 in case of error
+ */
+int write_request(BIO *bio, url_t *p_url, settings_t *s, limiter_t *lim) {
+    int ret;
 
+    string_slice_t *parts = p_url->url_parts;
     char request_b[INIT_NET_BUFF_SIZE];
     snprintf(request_b, INIT_NET_BUFF_SIZE, 
-        "GET %s%s%s " HTTP_VERSION "\r\n"
-        "Host: %s\r\n" //< Mandatory due to RFC2616
-        "Connection: close\r\n" //< Connection will be closed after completition of the response
+        "GET %.*s%.*s%.*s " HTTP_VERSION "\r\n"
+        "Host: %.*s\r\n" //< Mandatory due to RFC2616
+        "Connection: keep-alive\r\n" //< Connection can be reused by redirected request to the same origin (otherwise it is closed by client)
         "User-Agent: ISAFeedReader/1.0\r\n" //< Just to better filtering from the other traffic
         "\r\n",
-        p_url->url_parts[PATH]->str, 
-        !is_empty(p_url->url_parts[QUERY]) ? p_url->url_parts[QUERY]->str : "",
-        !is_empty(p_url->url_parts[FRAG_PART]) ? p_url->url_parts[FRAG_PART]->str : "",
-        p_url->url_parts[HOST]->str
+        (int)parts[PATH].len, parts[PATH].st, 
+        (int)parts[QUERY].len, parts[QUERY].st,
+        (int)parts[FRAG_PART].len, parts[FRAG_PART].st,
+        (int)parts[HOST].len, parts[HOST].st
     );
 
     #ifdef DEBUG
@@ -58,207 +61,609 @@ int send_request(BIO *bio, url_t *p_url, char *url) {
         fprintf(stderr, "%s\n", request_b);
     #endif
 
+    limiter_bytes(lim, strlen(request_b), nearest_deadline(s, 0));
+
     while((ret = BIO_write(bio, request_b, strlen(request_b))) <= 0) {
         if(!BIO_should_retry(bio)) { //< Checking if write should be repeated (in some cases is should be repeated even without SSL due to docs)
-            printerr(COMMUNICATION_ERROR, "Nepodarilo se odeslat HTTP zadost na '%s'!", url);
-            return COMMUNICATION_ERROR;
+            return -1;
+        }
+        else if((ret = wait_bio(bio, nearest_deadline(s, deadline_after(TIMEOUT_MS)))) <= 0) {
+            return ret;
+        }
+    }
+
+    return 1;
+}
+
+
+int send_request(BIO *bio, url_t *p_url, char *url, settings_t *s, limiter_t *lim, bool *stale) {
+    int ret = write_request(bio, p_url, s, lim);
+    if(ret == 0) {
+        printerr(COMMUNICATION_ERROR, "Vyprsel cas pro odeslani HTTP zadosti na '%s'!", url);
+        return COMMUNICATION_ERROR;
+    }
+    else if(ret < 0 && stale) { //< Reused connection was closed by server
+        *stale = true;
+        return COMMUNICATION_ERROR;
+    }
+    else if(ret < 0) {
+        printerr(COMMUNICATION_ERROR, "Nepodarilo se odeslat HTTP zadost na '%s'!", url);
+        return COMMUNICATION_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Reads available data to the given regions, plain sockets are read
+ * directly by readv (so more blocks can be filled by one syscall), otherwise
+ * the data must go through BIO (due to TLS layer)
+ */
+int read_chunk(BIO *bio, struct iovec *iov, size_t iov_n, bool is_plain) {
+    if(is_plain) {
+        int ret = readv(BIO_get_fd(bio, NULL), iov, iov_n);
+        if(ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            BIO_set_retry_read(bio); //< To be able to use BIO_should_retry in the same way as with BIO_read
         }
         else {
-            ret = poll(&pfd, 1, TIMEOUT_MS);
-            if(ret && !(pfd.revents & POLLIN)) {
-                printerr(COMMUNICATION_ERROR, "Nepodarilo se odeslat HTTP zadost na '%s'!", url);
-                return COMMUNICATION_ERROR;
-            }
+            BIO_clear_retry_flags(bio);
+        }
+
+        return ret;
+    }
+    else {
+        return BIO_read(bio, iov[0].iov_base, iov[0].iov_len);
+    }
+}
+
+
+/**
+ * @brief Searches the end of the header section (empty line) in the first
+ * segment of response buffer
+ * 
+ * @param hdrs Segment with headers
+ * @param scan_pos Position from which the searching starts (it is updated to skip already checked data)
+ * @param hdr_len Output parameter for length of headers (including the empty line)
+ * @return true if the end of headers was found
+ */
+bool find_hdrs_end(seg_t *hdrs, size_t *scan_pos, size_t *hdr_len) {
+    const size_t delim_len = strlen("\r\n\r\n");
+
+    for(size_t i = *scan_pos; i + delim_len <= hdrs->len; i++) {
+        if(hdrs->data[i] == '\r' && !strncmp(&(hdrs->data[i]), "\r\n\r\n", delim_len)) {
+            *hdr_len = i + delim_len;
+            return true;
+        }
+    }
+
+    *scan_pos = hdrs->len >= delim_len ? hdrs->len - delim_len + 1 : 0; //< Delimiter may be split between two reads
+
+    return false;
+}
+
+
+/**
+ * @brief Converts status slice of the parsed response to the number 
+ */
+int get_status_code(h_resp_t *p_resp) {
+    int status_c = 0;
+    for(size_t i = 0; i < p_resp->status.len; i++) { //< Status is always 3 digits long (see parse_first_line)
+        status_c = status_c*10 + (p_resp->status.st[i] - '0');
+    }
+
+    return status_c;
+}
+
+
+/**
+ * @brief Checks whether the connection option of response (case insensitive) contains the token
+ */
+bool has_conn_token(h_resp_t *p_resp, const char *token) {
+    string_slice_t *conn = &(p_resp->connection);
+    size_t token_len = strlen(token);
+    for(size_t i = 0; conn->st && i + token_len <= conn->len; i++) {
+        if(!strncasecmp(&(conn->st[i]), token, token_len)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief Decides whether the server keeps the connection open after the
+ * response (HTTP/1.1 does it by default, HTTP/1.0 only with keep-alive option)
+ */
+bool is_keep_alive(h_resp_t *p_resp) {
+    bool is_1_1 = p_resp->version.len == strlen("HTTP/1.1") && !strncasecmp(p_resp->version.st, "HTTP/1.1", p_resp->version.len);
+    if(is_1_1) {
+        return !has_conn_token(p_resp, "close");
+    }
+
+    return has_conn_token(p_resp, "keep-alive");
+}
+
+
+/**
+ * @brief Analyses received headers and determines the expected length
+ * of the whole response
+ * 
+ * @param resp_len Output parameter with expected length of response (0 if it is unknown)
+ */
+int proc_resp_hdrs(seg_buff_t *resp_b, h_resp_t *p_resp, size_t *resp_len, char *url) {
+    int ret = parse_http_resp(p_resp, resp_b->head->data, url);
+    if(ret != SUCCESS) {
+        return ret;
+    }
+
+    *resp_len = 0;
+    if(p_resp->content_len.st) {
+        string_slice_t *c_len = &(p_resp->content_len);
+        char *rest = NULL;
+
+        errno = 0;
+        unsigned long long body_len = strtoull(c_len->st, &rest, 10);
+        if(!isdigit((unsigned char)c_len->st[0]) || errno || skip_w_spaces(rest, true) != &(c_len->st[c_len->len])) {
+            printerr(HTTP_ERROR, "Neplatna hodnota hlavicky Content-Length v odpovedi z '%s'!", url);
+            return HTTP_ERROR;
         }
 
-        attempt_num++;
+        p_resp->body_len = body_len;
+        *resp_len = p_resp->hdr_len + body_len;
     }
 
+    p_resp->keep_alive = is_keep_alive(p_resp);
+
     return SUCCESS;
 }
 
 
-int rec_response(BIO *bio, string_t *resp_b, char *url) {
+/**
+ * @brief Limits total length of prepared regions to the given number of bytes 
+ */
+void limit_iov(struct iovec *iov, size_t *iov_n, size_t limit) {
+    size_t i = 0;
+    for(; i < *iov_n && limit > 0; i++) {
+        if(iov[i].iov_len > limit) {
+            iov[i].iov_len = limit;
+        }
+
+        limit -= iov[i].iov_len;
+    }
+
+    *iov_n = i;
+}
+
+
+int rec_response(BIO *bio, seg_buff_t *resp_b, h_resp_t *p_resp, char *url, settings_t *s, uint64_t first_byte_deadline, limiter_t *lim, bool *stale) {
     int ret = 0;
 
-    size_t emp_size = 0, total_b = 0;
+    struct iovec iov[2];
+    bool is_plain = BIO_find_type(bio, BIO_TYPE_SSL) == NULL; //< There is no TLS layer, socket can be read directly
+
+    bool hdrs_done = false;
+    size_t scan_pos = 0, resp_len = 0; //< Length of response is known after receiving of the headers (if there is Content-Length)
+
+    while(!resp_len || resp_b->total < resp_len) { //< Read until the whole message is received or connection is closed
+        size_t iov_n;
+        if(!hdrs_done) { //< Headers must be kept in the first segment (to be contiguous)
+            seg_t *hdrs = resp_b->head;
+            if(hdrs && hdrs->len == hdrs->size && !seg_realign(resp_b, 0, hdrs->size*2)) {
+                iov_n = 0;
+            }
+            else {
+                iov_n = seg_iov(resp_b, iov, 1);
+            }
+        }
+        else {
+            iov_n = seg_iov(resp_b, iov, is_plain ? 2 : 1);
+        }
+
+        if(!iov_n) {
+            printerr(INTERNAL_ERROR, "Chyba pri rozsirovani pameti pro HTTP odpoved!");
+            return INTERNAL_ERROR;
+        }
 
-    struct pollfd pfd;
-    pfd.fd = BIO_get_fd(bio, NULL);
-    pfd.events = POLLIN;
+        if(resp_len) { //< Do not read behind the end of message
+            limit_iov(iov, &iov_n, resp_len - resp_b->total);
+        }
 
-    while(ret > 0 || total_b == 0) { //< Extend buffer until there is something on the input
-        emp_size = resp_b->size - total_b;
-        while((ret = BIO_read(bio, &(resp_b->str[total_b]), emp_size)) <= 0) {
+        while((ret = read_chunk(bio, iov, iov_n, is_plain)) <= 0) {
             if(!BIO_should_retry(bio)) { //< Checking if read should be repeated, but is BIO_should_read returns false if there is nothing to read anymore
                 if(ret == 0) { //< Connection was closed
                     break;
                 }
-                
+
+                if(stale && !resp_b->total) { //< Reused connection was reset by server before response
+                    *stale = true;
+                    return COMMUNICATION_ERROR;
+                }
+
                 printerr(COMMUNICATION_ERROR, "Nepodarilo se ziskat HTTP odpoved od '%s'!", url);
                 return COMMUNICATION_ERROR;
             }
-            else { //< Read can be retried -> try it again (using poll)
-                ret = poll(&pfd, 1, TIMEOUT_MS);
-                if(ret && !(pfd.revents & POLLIN)) {
+            else { //< Read can be retried -> try it again (using poll), server must send the first byte until its deadline and then it must not be idle for more than TIMEOUT_MS
+                uint64_t deadline = resp_b->total ? nearest_deadline(s, deadline_after(TIMEOUT_MS)) : first_byte_deadline;
+                if((ret = wait_bio(bio, deadline)) == 0) {
+                    printerr(COMMUNICATION_ERROR, "Vyprsel cas pro prijeti HTTP odpovedi od '%s'! (prijato %zu B)", url, resp_b->total);
+                    return COMMUNICATION_ERROR;
+                }
+                else if(ret < 0) {
                     printerr(COMMUNICATION_ERROR, "Nepodarilo se ziskat HTTP odpoved od '%s'!", url);
                     return COMMUNICATION_ERROR;
                 }
             }
         }
 
-        total_b += ret;
-        if(resp_b->size == total_b) { //< Response is in whole buffer => extend it and try to read again
-            if(!(resp_b = ext_string(resp_b))) {
-                printerr(INTERNAL_ERROR, "Chyba pri rozsirovani pameti pro HTTP odpoved!");
-                return INTERNAL_ERROR;
+        if(ret == 0) {
+            break;
+        }
+
+        seg_commit(resp_b, ret);
+        limiter_bytes(lim, (size_t)ret, nearest_deadline(s, 0)); //< Server is slowed down by TCP flow control while the limiter waits
+
+        if(!hdrs_done && find_hdrs_end(resp_b->head, &scan_pos, &(p_resp->hdr_len))) {
+            hdrs_done = true;
+            if((ret = proc_resp_hdrs(resp_b, p_resp, &resp_len, url)) != SUCCESS) {
+                return ret;
+            }
+
+            if(!is_msg_needed(p_resp)) { //< Response will be rejected or redirected -> do not download the message 
+                p_resp->msg_skipped = true;
+                return SUCCESS;
+            }
+
+            if(resp_b->total < resp_len && p_resp->body_len <= MAX_RESERVED_MSG_SIZE) { //< Reserve exact space for the rest of message (if it fails or message is too large, blocks are used)
+                seg_realign(resp_b, p_resp->hdr_len, p_resp->body_len);
             }
         }
     }
 
+    if(!resp_b->total && stale) { //< Reused connection was closed by server before response
+        *stale = true;
+        return COMMUNICATION_ERROR;
+    }
+    else if(!resp_b->total) { //< Connection was closed before response (it is transient failure as reset)
+        printerr(COMMUNICATION_ERROR, "Server '%s' ukoncil spojeni bez odpovedi!", url);
+        return COMMUNICATION_ERROR;
+    }
+
+    if(!hdrs_done) {
+        printerr(HTTP_ERROR, "Hlavicky HTTP odpovedi z '%s' nebylo mozne najit!", url); //< RFC7230 p. 34
+        return HTTP_ERROR;
+    }
+
+    if(resp_len && resp_b->total < resp_len) { //< Connection was closed before the end of message
+        printerr(COMMUNICATION_ERROR, "Zkracena HTTP odpoved z '%s'! (prijato %zu B z %zu B)", url, 
+            resp_b->total - p_resp->hdr_len, p_resp->body_len);
+        return COMMUNICATION_ERROR;
+    }
+
     return SUCCESS;
 }
 
 
 /**
- * @brief Just auxiliary functions to free Openssl resources easily  
+ * @brief Copies host and port from URL to the buffers (OpenSSL needs null terminated strings) 
  */
-void free_https_connection(BIO *bio, SSL_CTX *ctx) {
-    BIO_free_all(bio);
-    SSL_CTX_free(ctx);
+int get_conn_params(url_t *p_url, char *host, char *port, char *url) {
+    if(!url_part_cstr(p_url, HOST, host, MAX_HOST_LEN + 1) || 
+       !url_part_cstr(p_url, PORT_PART, port, MAX_PORT_LEN + 1)) {
+        printerr(URL_ERROR, "Prilis dlouha adresa serveru nebo port v '%s'!", url);
+        return URL_ERROR;
+    }
+
+    return SUCCESS;
 }
 
 
 /**
- * @brief Loads path with certificates due to given settings_t structure
+ * @brief Gets connection to the server (connection kept after redirection or
+ * established in advance is used if there is any), message is printed if
+ * connection cannot be established
+ *
+ * @param reused Output parameter signalizing, that the connection was kept or
+ * established in advance (server could close it meanwhile)
  */
-int load_verify_paths(SSL_CTX *ctx, settings_t *s) {
-    if(s->certaddr) { //< Check whether folder exists and it is folder (to provide better troubleshooting)
-        struct stat stat_s;
-        memset(&stat_s, 0, sizeof(struct stat));
+int get_conn(conn_t *conn, bool tls, char *host, char *port, char *url, settings_t *s, net_t *net, bool *reused) {
+    int ret;
+    conn_init(conn);
+    *reused = false;
+    net->last_fail = CONN_FAIL_NONE;
 
-        if(stat(s->certaddr, &stat_s) || !S_ISDIR(stat_s.st_mode)) {
-            printerr(PATH_ERROR, "Zadana cesta '%s' nevede ke slozce!", s->certaddr);
-            return PATH_ERROR;
-        }
+    long failures;
+    if(!breaker_allow(&(net->breaker), host, port, &ret, &failures)) { //< Host is skipped with the error of its last failure
+        printerr(ret, "Server zdroje '%s' byl nedostupny pri %ld po sobe jdoucich behech, zdroj byl preskocen!", url, failures);
+        return ret;
     }
-     
-    int ret = 0;
-    if(!s->certfile && !s->certaddr) {
-        ret = SSL_CTX_set_default_verify_paths(ctx);
+
+    if(conn_take_kept(net, tls, host, port, conn)) { //< Connection to the same origin was kept after redirection
+        *reused = true;
+        return SUCCESS;
+    }
+
+    if(preconn_take(&(net->preconn), tls, host, port, conn, &ret)) { //< Connection could be idle for up to PRECONN_MAX_IDLE_MS
+        *reused = ret == SUCCESS;
     }
     else {
-        ret = SSL_CTX_load_verify_locations(ctx, s->certfile, s->certaddr); //< First is performed searching in file then in dir 
+        ret = conn_open(conn, tls, host, port, s, &(net->resolver), false, NULL);
     }
-   
-    if(ret == 0) { //< Setting of paths was not succesful
-        const char *appendix = s->certfile || s->certaddr ? "Prosim, zkontrolujte cesty!" : "";
-        printerr(PATH_ERROR, "Nepodarilo se nastavit cesty pro overeni certifikatu! %s", appendix);
-        return PATH_ERROR;
+
+    if(ret == CONNECTION_ERROR) {
+        conn_print_fail(conn, url);
+        net->last_fail = conn->fail;
+        breaker_record(&(net->breaker), host, port, ret);
     }
 
-    return SUCCESS;
-}
+    if(ret != SUCCESS) {
+        conn_close(conn);
+    }
 
+    return ret;
+}
 
-int https_load(url_t *p_url, string_t *resp_b, char *url, settings_t *s) {
-    int ret = SUCCESS;
 
-    //Based on IBM tutorial https://developer.ibm.com/tutorials/l-openssl/
-    SSL_CTX *ctx = SSL_CTX_new(SSLv23_client_method());
+/**
+ * @brief Checks certificate of the server (TLS handshake must be already done)
+ */
+int verify_conn(conn_t *conn, char *url, bool quiet) {
     SSL *ssl;
+    BIO_get_ssl(conn->bio, &ssl);
 
-    ret = load_verify_paths(ctx, s);
-    if(ret != SUCCESS) {
-        SSL_CTX_free(ctx);
+    long ret;
+    if((ret = SSL_get_verify_result(ssl)) != X509_V_OK) { //< Check verify result
+        if(!quiet) {
+            printerr(VERIFICATION_ERROR, "Nepodarilo se overit duveryhodnost certifikatu '%s'! (%s)", url, X509_verify_cert_error_string(ret));
+        }
+
+        return VERIFICATION_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+
+/**
+ * @brief Sends the hedged request through the second connection to the server,
+ * that is established by pre-connector (preferably to other address than the
+ * original one), failures are not reported (it is not sent if the rate of
+ * requests would be exceeded)
+ *
+ * @return int 1 if hedged request was sent, 0 if the connection is not
+ * established yet, -1 if hedged request cannot be sent
+ */
+int send_hedge(conn_t *hedge, bool tls, char *host, char *port, url_t *p_url, char *url, settings_t *s, net_t *net) {
+    int result, ret;
+    if((ret = preconn_try_take(&(net->preconn), tls, host, port, hedge, &result)) <= 0) {
         return ret;
     }
 
-    BIO *bio = BIO_new_ssl_connect(ctx);
-    BIO_get_ssl(bio, &ssl);
-    if(!ssl) {
-        printerr(INTERNAL_ERROR, "Chyba pri alokaci SSL struktury!");
-        SSL_CTX_free(ctx);
-        return INTERNAL_ERROR;
+    if(result != SUCCESS ||
+       !limiter_try_request(&(net->limiter)) || //< Hedged request must not wait for the limiter (the original one could respond meanwhile)
+       (tls && verify_conn(hedge, url, true) != SUCCESS) ||
+       write_request(hedge->bio, p_url, s, &(net->limiter)) <= 0) {
+        conn_close(hedge);
+        return -1;
     }
 
-    SSL_set_mode(ssl, SSL_MODE_AUTO_RETRY); //< Set ssl to auto retry to prevent errors caused by non-application data
-    //End of code based on https://developer.ibm.com/tutorials/l-openssl/
+    net->hedge.sent++;
 
-    if(!SSL_set_tlsext_host_name(ssl, p_url->url_parts[HOST]->str)) { //< Set Server Name Indication (if it is missing, self signed certificate error can occur)
-        printerr(INTERNAL_ERROR, "Chyba pri nastavovani SNI!");
-        free_https_connection(bio, ctx);
-        return INTERNAL_ERROR;
+    #ifdef DEBUG
+        fprintf(stderr, "Hedged request to %s\n", url);
+    #endif
+
+    return 1;
+}
+
+
+/**
+ * @brief Waits until the server starts to respond, if it takes longer than
+ * usually, the second connection is requested from pre-connector, the hedged
+ * request is sent through it as soon as it is established and the connection,
+ * that responds first, is moved to conn
+ *
+ * @param loser Output parameter for the slower connection (bio is NULL if there is no such connection)
+ * @param won_at Output parameter for time, when the hedged request won (0 if it did not win)
+ */
+void wait_first_byte(conn_t *conn, conn_t *loser, bool tls, char *host, char *port, url_t *p_url, char *url, 
+                     uint64_t deadline, settings_t *s, net_t *net, uint64_t *won_at) {
+    uint64_t start = mono_ms(), delay = hedge_delay(&(net->hedge), host, port);
+    uint64_t hedge_at = delay ? start + delay : 0, hedge_start = 0;
+    bool is_connecting = false; //< Connection for hedged request is being established (the original connection is polled meanwhile)
+
+    conn_t hedge;
+    conn_init(&hedge);
+    conn_init(loser);
+    *won_at = 0;
+
+    while(true) {
+        if(conn_responding(conn)) {
+            hedge_record(&(net->hedge), host, port, mono_ms() - start);
+            conn_close(&hedge);
+            return;
+        }
+
+        if(hedge.bio && conn_responding(&hedge)) { //< Hedged request won, the original connection is kept to estimate saved time
+            *won_at = mono_ms();
+            hedge_record(&(net->hedge), host, port, *won_at - hedge_start); //< Only time from the request to the first byte is recorded (as for the original request)
+            *loser = *conn;
+            *conn = hedge;
+            net->hedge.won++;
+            return;
+        }
+
+        if(hedge_at && mono_ms() >= hedge_at) {
+            hedge_at = 0;
+            is_connecting = preconn_request(&(net->preconn), tls, host, port, conn);
+        }
+
+        if(is_connecting) {
+            int ret = send_hedge(&hedge, tls, host, port, p_url, url, s, net);
+            hedge_start = mono_ms();
+            is_connecting = ret == 0;
+        }
+
+        uint64_t next_check = is_connecting ? deadline_after(HEDGE_CONN_CHECK_MS) : hedge_at;
+        struct pollfd fds[2] = {
+            {.fd = BIO_get_fd(conn->bio, NULL), .events = POLLIN},
+            {.fd = hedge.bio ? BIO_get_fd(hedge.bio, NULL) : -1, .events = POLLIN}, //< Negative descriptors are ignored by poll
+        };
+
+        int ret = poll(fds, 2, ms_left(min_deadline(deadline, next_check)));
+        if(ret < 0 && errno != EINTR) {
+            break;
+        }
+        else if(ret == 0 && deadline && mono_ms() >= deadline) { //< The first byte timeout is reported by rec_response
+            break;
+        }
     }
 
-    BIO_set_conn_hostname(bio, p_url->url_parts[HOST]->str); //< Always returns 1 -> no need to check retval
-    BIO_set_conn_port(bio, p_url->url_parts[PORT_PART]->str); //< -||-
+    conn_close(&hedge);
+}
+
 
-    if(BIO_do_connect(bio) <= 0) { //< Perform handshake
-        printerr(CONNECTION_ERROR, "Nelze se spojit s '%s'!", url);
-        free_https_connection(bio, ctx);
-        return CONNECTION_ERROR;
+/**
+ * @brief Reads the rest of skipped message of redirection, so the connection
+ * can be used for the next request (only short messages are read)
+ *
+ * @return true if the whole response was read and the connection can be kept
+ */
+bool drain_msg(BIO *bio, seg_buff_t *resp_b, h_resp_t *p_resp, settings_t *s, limiter_t *lim) {
+    if(!p_resp->keep_alive || !p_resp->content_len.st || get_status_code(p_resp)/100 != 3) {
+        return false;
     }
 
-    if((ret = SSL_get_verify_result(ssl)) != X509_V_OK) { //< Check verify result
-        printerr(VERIFICATION_ERROR, "Nepodarilo se overit duveryhodnost certifikatu '%s'! (%s)", url, X509_verify_cert_error_string(ret));
-        free_https_connection(bio, ctx);
-        return VERIFICATION_ERROR;
+    size_t resp_len = p_resp->hdr_len + p_resp->body_len;
+    if(resp_b->total > resp_len || resp_len - resp_b->total > MAX_DRAINED_MSG_SIZE) { //< Unexpected data or too long message
+        return false;
     }
-    
-    if((ret = send_request(bio, p_url, url)) != SUCCESS) { //< Send request to the server
-        free_https_connection(bio, ctx);
-        return ret;
+
+    char buff[INIT_NET_BUFF_SIZE];
+    size_t rest = resp_len - resp_b->total;
+    while(rest > 0) {
+        int ret = BIO_read(bio, buff, rest < sizeof(buff) ? (int)rest : (int)sizeof(buff));
+        if(ret > 0) {
+            rest -= (size_t)ret;
+            limiter_bytes(lim, (size_t)ret, nearest_deadline(s, 0));
+        }
+        else if(!BIO_should_retry(bio) || wait_bio(bio, nearest_deadline(s, deadline_after(TIMEOUT_MS))) <= 0) {
+            return false;
+        }
     }
 
-    if((ret = rec_response(bio, resp_b, url)) != SUCCESS) { //< Receive response
-        free_https_connection(bio, ctx);
+    return true;
+}
+
+
+/**
+ * @brief Sends request through the connection and receives the response
+ * (hedged request is sent if the server is slow and hedging is enabled)
+ *
+ * @param stale If it is not NULL, failure of the connection before response is
+ * not reported and it is signalized by this output parameter (for reused connections)
+ */
+int exchange(conn_t *conn, bool tls, char *host, char *port, url_t *p_url, seg_buff_t *resp_b, h_resp_t *p_resp, char *url, settings_t *s, net_t *net, bool *stale) {
+    limiter_select_host(&(net->limiter), host);
+    limiter_request(&(net->limiter), nearest_deadline(s, 0)); //< Wait if the rate of requests would be exceeded
+
+    int ret;
+    if((ret = send_request(conn->bio, p_url, url, s, &(net->limiter), stale)) != SUCCESS) { //< Send request to the server
         return ret;
     }
-    
+
+    uint64_t first_byte_deadline = phase_deadline(s, TO_FIRST_BYTE), won_at = 0;
+
+    conn_t loser;
+    conn_init(&loser);
+    if(s->hedge_flag) {
+        wait_first_byte(conn, &loser, tls, host, port, p_url, url, first_byte_deadline, s, net, &won_at);
+    }
+
+    bool *resp_stale = loser.bio ? NULL : stale; //< Response through the hedged connection is not from reused connection
+    ret = rec_response(conn->bio, resp_b, p_resp, url, s, first_byte_deadline, &(net->limiter), resp_stale); //< Receive response
+    if(ret == SUCCESS && p_resp->msg_skipped && drain_msg(conn->bio, resp_b, p_resp, s, &(net->limiter))) { //< Redirection to the same origin can reuse the connection
+        conn_keep(net, conn, tls, host, port);
+    }
+
+    if(loser.bio) {
+        if(!conn_responding(&loser)) { //< The original request would be completed later than now at least by the time between the first bytes of responses
+            net->hedge.saved_ms += mono_ms() - won_at;
+        }
+
+        conn_close(&loser);
+    }
+
     #ifdef DEBUG
-        fprintf(stderr, "Response (%ld):\n%s\n", strlen(resp_b->str), resp_b->str);
+        fprintf(stderr, "Response (%ld B) in %s\n", resp_b->total, url);
     #endif
 
-    free_https_connection(bio, ctx);
-    return SUCCESS;
+    return ret;
 }
 
 
-int http_load(url_t *parsed_url, string_t *resp_b, char *url) {
+/**
+ * @brief Gets connection to the server and exchanges request and response
+ * through it, if the reused connection was closed by server before response
+ * (keep-alive race), the request is repeated once through new connection
+ */
+int fetch_resp(bool tls, url_t *p_url, seg_buff_t *resp_b, h_resp_t *p_resp, char *url, settings_t *s, net_t *net) {
     int ret;
-    BIO *bio = BIO_new(BIO_s_connect());
-    if(!bio) {
-        printerr(INTERNAL_ERROR, "Chyba pri alokaci BIO struktury!");
-        return INTERNAL_ERROR;
-    }
-
-    BIO_set_conn_hostname(bio, parsed_url->url_parts[HOST]->str); //< Always returns 1 -> no need to check retval
-    BIO_set_conn_port(bio, parsed_url->url_parts[PORT_PART]->str); //< -||-
 
-    if(BIO_do_connect(bio) <= 0) {
-        printerr(CONNECTION_ERROR, "Nelze se spojit s '%s'!", url);
-        BIO_free_all(bio);
-        return CONNECTION_ERROR;
-    }
-    
-    if((ret = send_request(bio, parsed_url, url)) != SUCCESS) {
-        BIO_free_all(bio);
+    char host[MAX_HOST_LEN + 1], port[MAX_PORT_LEN + 1];
+    if((ret = get_conn_params(p_url, host, port, url)) != SUCCESS) {
         return ret;
     }
 
-    if((ret = rec_response(bio, resp_b, url)) != SUCCESS) {
-        BIO_free_all(bio);
+    conn_t conn;
+    bool reused, stale = false;
+    if((ret = get_conn(&conn, tls, host, port, url, s, net, &reused)) != SUCCESS) {
         return ret;
     }
 
-    #ifdef DEBUG
-        fprintf(stderr, "Response (%ld):\n%s\n", strlen(resp_b->str), resp_b->str);
-    #endif
+    if(!tls || (ret = verify_conn(&conn, url, false)) == SUCCESS) {
+        ret = exchange(&conn, tls, host, port, p_url, resp_b, p_resp, url, s, net, reused ? &stale : NULL);
+    }
 
-    BIO_free_all(bio);
+    if(stale) { //< Server did not process the request, so it can be repeated
+        #ifdef DEBUG
+            fprintf(stderr, "Reused connection to %s was closed, request is repeated\n", url);
+        #endif
 
-    return SUCCESS;
+        conn_close(&conn);
+        seg_buff_reset(resp_b);
+        init_h_resp(p_resp);
+
+        if((ret = conn_open(&conn, tls, host, port, s, &(net->resolver), false, NULL)) == CONNECTION_ERROR) {
+            conn_print_fail(&conn, url);
+            net->last_fail = conn.fail;
+        }
+
+        if(ret == SUCCESS && (!tls || (ret = verify_conn(&conn, url, false)) == SUCCESS)) {
+            ret = exchange(&conn, tls, host, port, p_url, resp_b, p_resp, url, s, net, NULL);
+        }
+    }
+
+    breaker_record(&(net->breaker), host, port, ret);
+    conn_close(&conn);
+    return ret;
+}
+
+
+int https_load(url_t *p_url, seg_buff_t *resp_b, h_resp_t *p_resp, char *url, settings_t *s, net_t *net) {
+    return fetch_resp(true, p_url, resp_b, p_resp, url, s, net);
+}
+
+
+int http_load(url_t *parsed_url, seg_buff_t *resp_b, h_resp_t *p_resp, char *url, settings_t *s, net_t *net) {
+    return fetch_resp(false, parsed_url, resp_b, p_resp, url, s, net);
+}
+
+
+bool is_permanent_redir(h_resp_t *p_resp) {
+    int status_c = get_status_code(p_resp);
+    return status_c == 301 || status_c == 308;
 }
 
 
@@ -278,8 +683,29 @@ int check_http_status(int status_c, string_t *phrase, char *url) {
 }
 
 
-int http_redirect(h_resp_t *p_resp, list_el_t *cur_url) {
-    if(cur_url->indirect_lvl >= MAX_REDIR_NUM) {
+int http_redirect_to(url_tab_t *tab, size_t cur, const char *url, size_t len) {
+    if(tab->indirect_lvl[cur] >= MAX_REDIR_NUM) {
+        printerr(HTTP_ERROR, "Byl dosazen maximalni pocet presmerovani (%d)!", MAX_REDIR_NUM);
+        return HTTP_ERROR;
+    }
+
+    //< New URL is added to the end of table and the current URL points to it
+    size_t new_i = url_tab_append(tab, url, len, tab->indirect_lvl[cur] + 1);
+    if(new_i == URL_TAB_NONE) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se vytvorit strukturu pro presmerovani z '%s'!", tab->url[cur]);
+        return INTERNAL_ERROR;
+    }
+
+    tab->redir[cur] = new_i;
+
+    printw("Presmerovano na '%s'!", tab->url[new_i]);
+
+    return SUCCESS;
+}
+
+
+int http_redirect(h_resp_t *p_resp, url_tab_t *tab, size_t cur) {
+    if(tab->indirect_lvl[cur] >= MAX_REDIR_NUM) {
         printerr(HTTP_ERROR, "Byl dosazen maximalni pocet presmerovani (%d)!", MAX_REDIR_NUM);
         return HTTP_ERROR;
     }
@@ -293,27 +719,25 @@ int http_redirect(h_resp_t *p_resp, list_el_t *cur_url) {
         bool is_path_result = false;
         int ret;
         if((ret = is_path(&is_path_result, location_str->str)) != SUCCESS) { //< Check if it is only path
+            string_dtor(location_str);
             return ret;
         }
 
         if(is_path_result) { //< If yes -> recycle old URL with new path (or append it if it is relative path)
-            string_t *tmp = replace_path(cur_url->string, location_str);
+            string_t *tmp = replace_path(tab->url[cur], location_str);
             string_dtor(location_str);
             location_str = tmp;
+            if(!location_str) {
+                printerr(INTERNAL_ERROR, "Nepodarilo se sestavit URL pro presmerovani z '%s'!", tab->url[cur]);
+                return INTERNAL_ERROR;
+            }
         }
 
-        list_el_t *new_element = new_element_non_dup(location_str); //< Create new element for linked list with URLs
-        if(!new_element) {
-            printerr(INTERNAL_ERROR, "Nepodarilo se vytvorit strukturu pro presmerovani z '%s'!", cur_url->string->str);
-            return INTERNAL_ERROR;
+        ret = http_redirect_to(tab, cur, location_str->str, strlen(location_str->str));
+        string_dtor(location_str);
+        if(ret != SUCCESS) {
+            return ret;
         }
-
-        printw("Presmerovano na '%s'!", location_str->str);
-
-        new_element->result = SUCCESS;
-        new_element->indirect_lvl = cur_url->indirect_lvl + 1; //< Increase redirection lvl (for safety reason)
-        new_element->next = cur_url->next; //< Adding new element (URL) after curretnly processed URL
-        cur_url->next = new_element;
     }
     else {
         printerr(HTTP_ERROR, "Presmerovani se nepodarilo! Hlavicka Location nebyla nalezena v HTTP odpovedi!");
@@ -354,89 +778,144 @@ void free_all_patterns(regex_t *regexes, int r_num) {
 }
 
 
-//Patterns for checking mime types
-int prepare_mime_patterns(regex_t *regexes) {
-    char *patterns[MIME_NUM] = {
-        "^" RSS_MIME, 
-        "^" ATOM_MIME, 
-        "^" XML_MIME,
-    };
+/**
+ * @brief Table with supported MIME types (lengths are computed at compile time)
+ */
+const mime_type_t mime_types[] = {
+    { RSS_MIME, sizeof(RSS_MIME) - 1, RSS },
+    { ATOM_MIME, sizeof(ATOM_MIME) - 1, ATOM },
+    { XML_MIME, sizeof(XML_MIME) - 1, XML },
+    { XML_APP_MIME, sizeof(XML_APP_MIME) - 1, XML },
+};
 
-    for(int i = 0; i < MIME_NUM; i++) {
-        if(regcomp(&(regexes[i]), patterns[i], REG_EXTENDED | REG_ICASE)) { //< We will need extended posix notation and case insensitive matching 
-            printerr(INTERNAL_ERROR, "Chyba pri kompilaci regularniho vyrazu! %d", i);
-            return INTERNAL_ERROR;
+
+/**
+ * @brief Parses parameters of media type (see RFC7231 p. 8), only the charset
+ * parameter is stored (to the charset field of p_resp) 
+ * 
+ * @param cur Ptr to the part of Content-Type value behind the media type
+ * @param end Ptr to the end of the Content-Type value
+ * @param p_resp Parsed response
+ */
+void parse_mime_params(char *cur, char *end, h_resp_t *p_resp) {
+    while(cur < end) {
+        while(cur < end && (isspace((unsigned char)*cur) || *cur == ';')) { //< Skip delimiters
+            cur++;
         }
-    }
 
-    return SUCCESS;
+        char *name = cur;
+        while(cur < end && *cur != '=' && *cur != ';' && !isspace((unsigned char)*cur)) {
+            cur++;
+        }
+
+        size_t name_len = cur - name;
+        if(cur >= end || *cur != '=') { //< Malformed parameter -> skip it
+            continue;
+        }
+
+        char *value = ++cur; //< Skip '='
+        if(cur < end && *cur == '"') { //< Value is quoted string
+            value = ++cur;
+            while(cur < end && *cur != '"') {
+                cur++;
+            }
+        }
+        else {
+            while(cur < end && *cur != ';' && !isspace((unsigned char)*cur)) {
+                cur++;
+            }
+        }
+
+        size_t value_len = cur - value;
+        if(cur < end && *cur == '"') {
+            cur++;
+        }
+
+        bool is_charset = name_len == strlen("charset") && !strncasecmp(name, "charset", name_len);
+        if(is_charset && value_len > 0 && value_len <= MAX_CHARSET_LEN) {
+            memcpy(p_resp->charset, value, value_len);
+            p_resp->charset[value_len] = '\0';
+        }
+    }
 }
 
 
 /**
- * @brief Determines MIME type of response 
+ * @brief Classifies MIME type from Content-Type header (without any messages
+ * and allocations), the charset parameter is extracted too
+ * 
+ * @return SUCCESS if MIME type is supported, otherwise HTTP_ERROR
  */
-int find_mime(h_resp_t *p_resp, char *url) {
-    regex_t re[MIME_NUM];
-    regmatch_t match[MIME_NUM];
-
-    int ret;
+int classify_mime(h_resp_t *p_resp) {
+    char *cur = p_resp->content_type.st;
+    char *end = &(cur[p_resp->content_type.len]);
 
-    if((ret = prepare_mime_patterns(re)) != SUCCESS) {
-        return ret;
+    char *type_end = cur;
+    while(type_end < end && *type_end != ';' && !isspace((unsigned char)*type_end)) {
+        type_end++;
     }
 
-    string_t *content_type = slice2string(&(p_resp->content_type)); //Temporary string
-    if(!content_type) {
-        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat docasnou pamet pro MIME typ!");
-        return INTERNAL_ERROR;
-    }
+    size_t type_len = type_end - cur;
+    size_t types_num = sizeof(mime_types)/sizeof(mime_type_t);
+    for(size_t i = 0; i < types_num; i++) {
+        const mime_type_t *m_type = &(mime_types[i]);
+        if(m_type->len == type_len && !strncasecmp(cur, m_type->name, type_len)) { //< Media types are case insensitive
+            p_resp->doc_type = m_type->doc_type;
+            parse_mime_params(type_end, end, p_resp);
 
-    ret = HTTP_ERROR;
-    char *con_type_str = content_type->str;
-    for(int i = 0; i < MIME_NUM; i++) {
-        int res = regexec(&(re[i]), con_type_str, 1, &(match[i]), 0);
-        if(res == 0) { //< There is any of allowed MIME types
-            p_resp->doc_type = i; //< Set MIME type
-            ret = SUCCESS;
-            break;
+            return SUCCESS;
         }
     }
 
+    return HTTP_ERROR;
+}
+
+
+/**
+ * @brief Determines MIME type of response 
+ */
+int find_mime(h_resp_t *p_resp, char *url) {
+    int ret = classify_mime(p_resp);
+
     if(ret != SUCCESS) {
-        printerr(HTTP_ERROR, "MIME typ '%s' dokumentu z '%s' neni programem podporovan!", content_type->str, url);
+        int len = p_resp->content_type.len;
+        printerr(HTTP_ERROR, "MIME typ '%.*s' dokumentu z '%s' neni programem podporovan!", len, p_resp->content_type.st, url);
     }
 
-    free_all_patterns(re, MIME_NUM);
-    string_dtor(content_type);
-
     return ret;
 }
 
 
-
-int check_http_resp(h_resp_t *p_resp, list_el_t *cur_url, char *url) {
-    string_t *status = slice2string(&(p_resp->status));
-    if(!status) {
-        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro status HTTP odpovedi!");
-        return INTERNAL_ERROR;
+bool is_msg_needed(h_resp_t *p_resp) {
+    if(get_status_code(p_resp) != 200) { //< Only successful responses contain documents (see check_http_status)
+        return false;
     }
 
+    #ifdef CHECK_MIME_TYPE
+        if(p_resp->content_type.st && classify_mime(p_resp) == HTTP_ERROR) { //< Unsupported document
+            return false;
+        }
+    #endif
+
+    return true;
+}
+
+
+
+int check_http_resp(h_resp_t *p_resp, url_tab_t *tab, size_t cur, char *url) {
     string_t *phrase = slice2string(&(p_resp->phrase));
-    if(!status) {
+    if(!phrase) {
         printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro HTTP frazi!");
         return INTERNAL_ERROR;
     }
 
-    char *rest = NULL;
-    int status_c = strtoul(status->str, &rest, 10);
+    int status_c = get_status_code(p_resp);
     int ret = check_http_status(status_c, phrase, url);
 
     string_dtor(phrase);
-    string_dtor(status);
 
     if(ret == HTTP_REDIRECT) { //< Perform redirect (due to status)
-        ret = http_redirect(p_resp, cur_url);
+        ret = http_redirect(p_resp, tab, cur);
         if(ret == SUCCESS) {
             return HTTP_REDIRECT;
         }
@@ -456,13 +935,14 @@ int check_http_resp(h_resp_t *p_resp, list_el_t *cur_url, char *url) {
 
 int prepare_resp_patterns(regex_t *regexes) {
     char *patterns[RE_H_RESP_NUM] = { //< There is always ^ because we always match pattern from start of the string 
-        "^(.|\r\n)*\r\n\r\n",
         "^.*\r\n",
         "^[^ \t]*",
         "^[0-9]{3}",
         "^[^\r\n]*",
         "^Location:",
-        "^Content-Type:"
+        "^Content-Type:",
+        "^Content-Length:",
+        "^Connection:"
     };
 
     for(int i = 0; i < RE_H_RESP_NUM; i++) {
@@ -500,6 +980,20 @@ void parse_hdrs(char *line_end, resp_parse_ctx_t *ctx, h_resp_t *p_resp) {
         size_t len = (size_t)(line_end - *cursor);
         p_resp->content_type = new_str_slice(*cursor, len - strlen("\r\n"));
     }
+
+    res[CON_LEN] = regexec(&(regexes[CON_LEN]), *cursor, 1, &(matches[CON_LEN]), 0);
+    if(res[CON_LEN] != REG_NOMATCH) { //< It is content-length header! (the end of message can be recognized)
+        *cursor =  skip_w_spaces(&((*cursor)[matches[CON_LEN].rm_eo]), true);
+        size_t len = (size_t)(line_end - *cursor);
+        p_resp->content_len = new_str_slice(*cursor, len - strlen("\r\n"));
+    }
+
+    res[CONN_HDR] = regexec(&(regexes[CONN_HDR]), *cursor, 1, &(matches[CONN_HDR]), 0);
+    if(res[CONN_HDR] != REG_NOMATCH) { //< It is connection header! (it decides whether connection can be reused)
+        *cursor =  skip_w_spaces(&((*cursor)[matches[CONN_HDR].rm_eo]), true);
+        size_t len = (size_t)(line_end - *cursor);
+        p_resp->connection = new_str_slice(*cursor, len - strlen("\r\n"));
+    }
 }
 
 
@@ -586,14 +1080,11 @@ int parse_resp_headers(resp_parse_ctx_t *ctx, h_resp_t *p_resp, char *hdrs_start
 }
 
 
-int parse_http_resp(h_resp_t *parsed_resp, string_t *response, char *url) {
+int parse_http_resp(h_resp_t *parsed_resp, char *resp, char *url) {
     resp_parse_ctx_t ctx;
     int ret = SUCCESS;
-    char *resp = response->str;
 
     regex_t *regexes = ctx.regexes;
-    regmatch_t *matches = ctx.regm;
-    int *res = ctx.res;
 
     if((ret = prepare_resp_patterns(regexes)) != SUCCESS) { //< Preparation of POSIX regex structures
         return ret;
@@ -601,16 +1092,7 @@ int parse_http_resp(h_resp_t *parsed_resp, string_t *response, char *url) {
 
     init_resp_res_arr(ctx.res);
 
-    res[H_PART] = regexec(&regexes[H_PART], resp, 1, &(matches[H_PART]), 0);
-
-    if(res[H_PART] == REG_NOMATCH) {
-        printerr(HTTP_ERROR, "Hlavicky HTTP odpovedi z '%s' nebylo mozne najit!", url); //< RFC7230 p. 34
-        ret = HTTP_ERROR;
-    }
-    else {
-        parsed_resp->msg = &(resp[matches[H_PART].rm_eo]);
-        ret = parse_resp_headers(&ctx, parsed_resp, response->str, url);
-    }
+    ret = parse_resp_headers(&ctx, parsed_resp, resp, url);
 
     #ifdef DEBUG
         fprintf(stderr, "Length: st=%p len=%ld\n", parsed_resp->content_len.st, parsed_resp->content_len.len);
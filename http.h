@@ -16,9 +16,13 @@
 #include <poll.h>
 #include <regex.h>
 #include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 #include <openssl/bio.h>
 #include <openssl/err.h>
@@ -27,10 +31,13 @@
 #include "common.h"
 #include "cli.h"
 #include "url.h"
+#include "conn.h"
 
 #define HTTP_REDIRECT -1 //< Return value signalizing http redirection 
 #define MAX_REDIR_NUM 5 //< Maximum amount of redirections to prevent redirection cycle
-#define TIMEOUT_MS 3000 //< Maximum time in ms for waiting for the writing/reading from BIO socket
+#define TIMEOUT_MS 3000 //< Maximum time in ms, for which the server can be idle during sending of request and receiving of response
+#define MAX_DRAINED_MSG_SIZE 16384 //< Maximum size of skipped message of redirection, that is read to keep the connection open
+#define MAX_RESERVED_MSG_SIZE (4*1024*1024) //< Maximum size of message, for which exact space is reserved by Content-Length (larger ones are received to blocks)
 
 #define HTTP_VERSION "HTTP/1.0" //< HTTP version (used in request)
 
@@ -40,22 +47,37 @@
  * 
  */
 enum re_h_resp_indexes {
-    H_PART, //< Part with headers
     LINE, //< Line with hdr
     VER,
     STAT,
     PHR,
     LOC,
     CON_TYPE,
+    CON_LEN,
+    CONN_HDR,
     RE_H_RESP_NUM, //< Maximum amount of tokens in URL 
 };
 
 #define CHECK_MIME_TYPE
 
 
-#define ATOM_MIME "application/atom\\+xml"
-#define RSS_MIME "application/rss\\+xml"
-#define XML_MIME "(text/xml)|(application/xml)"
+#define ATOM_MIME "application/atom+xml"
+#define RSS_MIME "application/rss+xml"
+#define XML_MIME "text/xml"
+#define XML_APP_MIME "application/xml"
+
+#define MAX_CHARSET_LEN 63 //< Longer charset parameters of Content-Type are ignored
+
+
+/**
+ * @brief Item of the table with supported MIME types
+ * 
+ */
+typedef struct mime_type {
+    const char *name; //< Media type (type/subtype)
+    size_t len; //< Length of the media type
+    doc_type_t doc_type; //< Related document type
+} mime_type_t;
 
 
 /**
@@ -64,8 +86,13 @@ enum re_h_resp_indexes {
  */
 typedef struct h_resp {
     string_slice_t version, status, phrase;
-    string_slice_t location, content_type, content_len;
+    string_slice_t location, content_type, content_len, connection;
     doc_type_t doc_type;
+    char charset[MAX_CHARSET_LEN + 1]; //< Value of charset parameter of Content-Type (or empty string)
+    size_t hdr_len; //< Length of the header section (including the empty line)
+    size_t body_len; //< Length of the message declared by Content-Length (valid only if content_len is set)
+    bool msg_skipped; //< Message was not received, because response will be rejected (or redirected) anyway
+    bool keep_alive; //< Server keeps the connection open after the response (due to version and Connection header)
     char *msg; //< Ptr to the start of the response message
 } h_resp_t;
 
@@ -96,27 +123,60 @@ void openssl_cleanup();
 
 
 /**
- * @brief Sends HTTP request to server with given analyzed URL
+ * @brief Sends HTTP request to server with given analyzed URL (bytes of
+ * request are accounted by the limiter)
+ *
+ * @param stale If it is not NULL, failure of writing is not reported and it is
+ * signalized by this output parameter (server closed reused connection)
  */
-int send_request(BIO *bio, url_t *p_url, char *url);
+int send_request(BIO *bio, url_t *p_url, char *url, settings_t *s, limiter_t *lim, bool *stale);
 
 
 /**
- * @brief Fetching reponse from HTTP server
+ * @brief Fetching reponse from HTTP server (headers are analysed as soon as
+ * they are received, the reading stops at the end of message if its length is known)
+ * @note The first byte must be received until first_byte_deadline, then the
+ * server must not be idle for more than TIMEOUT_MS, received bytes are accounted
+ * by the limiter (reading is delayed if the rate would be exceeded)
+ *
+ * @param stale If it is not NULL, closing or reset of connection before the
+ * first byte of response is not reported and it is signalized by this output
+ * parameter (server closed reused connection)
  */
-int rec_response(BIO *bio, string_t *resp_b, char *url);
+int rec_response(BIO *bio, seg_buff_t *resp_b, h_resp_t *p_resp, char *url, settings_t *s, uint64_t first_byte_deadline, limiter_t *lim, bool *stale);
 
 
 /**
  * @brief Provides sending request, verification and fetching data for HTTPS 
+ * @note Connection established in advance by pre-connector of net is used if
+ * there is any, hedged request is sent to slow server if hedging is enabled,
+ * request is repeated once through new connection if the reused connection
+ * was closed by server before response
  */
-int https_load(url_t *p_url, string_t *resp_b, char *url, settings_t *s);
+int https_load(url_t *p_url, seg_buff_t *resp_b, h_resp_t *p_resp, char *url, settings_t *s, net_t *net);
 
 
 /**
  * @brief Provides sending request and fetching data for HTTP
+ * @note Connection established in advance by pre-connector of net is used if
+ * there is any, hedged request is sent to slow server if hedging is enabled,
+ * request is repeated once through new connection if the reused connection
+ * was closed by server before response
+ */
+int http_load(url_t *parsed_url, seg_buff_t *resp_b, h_resp_t *p_resp, char *url, settings_t *s, net_t *net);
+
+
+/**
+ * @brief Determines whether the message of response is worth receiving (it is
+ * decided only by headers, no messages are printed)
+ */
+bool is_msg_needed(h_resp_t *p_resp);
+
+
+/**
+ * @brief Checks whether the response is permanent redirection (301 or 308)
  */
-int http_load(url_t *parsed_url, string_t *resp_b, char *url);
+bool is_permanent_redir(h_resp_t *p_resp);
 
 
 /**
@@ -128,19 +188,26 @@ int check_http_status(int status_c, string_t *phrase, char *url);
 /**
  * @brief Performs HTTP redirection
  */
-int http_redirect(h_resp_t *p_resp, list_el_t *cur_url);
+int http_redirect(h_resp_t *p_resp, url_tab_t *tab, size_t cur);
+
+
+/**
+ * @brief Redirects URL in the table to the given (absolute) URL 
+ * @note It is used also for redirections, that are already known (cached)
+ */
+int http_redirect_to(url_tab_t *tab, size_t cur, const char *url, size_t len);
 
 
 /**
  * @brief Checks the validity of HTTP response
  */
-int check_http_resp(h_resp_t *p_resp, list_el_t *cur_url, char *url);
+int check_http_resp(h_resp_t *p_resp, url_tab_t *tab, size_t cur, char *url);
 
 
 /**
- * @brief Analyses HTTP response
+ * @brief Analyses headers of HTTP response (hdr_len of parsed_resp must be already set)
  */
-int parse_http_resp(h_resp_t *parsed_resp, string_t *response, char *url);
+int parse_http_resp(h_resp_t *parsed_resp, char *response, char *url);
 
 
 /**
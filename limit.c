@@ -0,0 +1,332 @@
+/**
+ * @file limit.c
+ * @brief Src file of module with limiter of rates of requests and
+ * transferred bytes (token buckets), the state of buckets can be shared by
+ * more instances through the limit file
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 11. 11. 2022
+ */
+
+#include "limit.h"
+
+
+/**
+ * @brief Adds tokens for the time from the last refill (burst is amount of tokens for one second)
+ */
+void bucket_refill(bucket_t *bucket, long rate, uint64_t now) {
+    if(!bucket->last) { //< Bucket was not used yet
+        bucket->tokens = (double)rate;
+    }
+    else if(bucket->last < now) { //< Time of other boot (in the shared state) is not considered
+        bucket->tokens += (double)(now - bucket->last)*rate/1000.0;
+    }
+
+    if(bucket->tokens > (double)rate) {
+        bucket->tokens = (double)rate;
+    }
+
+    bucket->last = now;
+}
+
+
+/**
+ * @brief Takes tokens from the bucket (it can get into the debt)
+ *
+ * @return uint64_t Time in ms, after which the debt is paid
+ */
+uint64_t bucket_take(bucket_t *bucket, long rate, double n, uint64_t now) {
+    bucket_refill(bucket, rate, now);
+    bucket->tokens -= n;
+
+    return bucket->tokens < 0 ? (uint64_t)(-bucket->tokens*1000.0/rate) + 1 : 0;
+}
+
+
+/**
+ * @brief Locks the shared state (the state of one instance is not locked)
+ */
+void limiter_lock(limiter_t *lim) {
+    if(lim->fd >= 0) {
+        while(flock(lim->fd, LOCK_EX) < 0 && errno == EINTR);
+    }
+}
+
+
+/**
+ * @brief Unlocks the shared state
+ */
+void limiter_unlock(limiter_t *lim) {
+    if(lim->fd >= 0) {
+        flock(lim->fd, LOCK_UN);
+    }
+}
+
+
+/**
+ * @brief Checks whether the bucket would be full after refill (its owner does
+ * not have to be remembered)
+ */
+bool bucket_is_full(bucket_t *bucket, long rate, uint64_t now) {
+    if(!rate || !bucket->last || bucket->last > now) { //< Unused bucket or bucket from other boot
+        return true;
+    }
+
+    return bucket->tokens + (double)(now - bucket->last)*rate/1000.0 >= (double)rate;
+}
+
+
+/**
+ * @brief Returns buckets of the current host, slots are searched by linear
+ * probing, the host takes the first probed slot, whose buckets are full
+ * (empty slot or slot of host, that was not used for a while), if there is
+ * no such slot, the host shares buckets of its home slot with their owner
+ * (so colliding hosts cannot refill each other's buckets)
+ * @note State must be locked
+ */
+limit_host_t *limiter_host(limiter_t *lim, uint64_t now) {
+    limit_host_t *free_slot = NULL;
+    for(size_t i = 0; i < LIMIT_HOST_PROBES; i++) {
+        limit_host_t *host = &(lim->state->hosts[(lim->host_hash + i) % LIMIT_HOST_SLOTS]);
+        if(host->hash == lim->host_hash) {
+            return host;
+        }
+
+        if(!free_slot && bucket_is_full(&(host->bytes), lim->rates[LIM_HOST_BYTES], now) &&
+           bucket_is_full(&(host->reqs), lim->rates[LIM_HOST_REQS], now)) {
+            free_slot = host;
+        }
+    }
+
+    if(!free_slot) {
+        return &(lim->state->hosts[lim->host_hash % LIMIT_HOST_SLOTS]);
+    }
+
+    memset(free_slot, 0, sizeof(limit_host_t));
+    free_slot->hash = lim->host_hash;
+
+    return free_slot;
+}
+
+
+/**
+ * @brief Takes given amount of bytes and requests from global buckets and
+ * buckets of the current host
+ *
+ * @return uint64_t Time in ms, that must be waited out
+ */
+uint64_t limiter_take(limiter_t *lim, double bytes, double reqs) {
+    uint64_t now = mono_ms(), wait = 0, w;
+    long *rates = lim->rates;
+
+    limiter_lock(lim);
+
+    limit_host_t *host = limiter_host(lim, now);
+    if(bytes > 0 && rates[LIM_BYTES] && (w = bucket_take(&(lim->state->bytes), rates[LIM_BYTES], bytes, now)) > wait) {
+        wait = w;
+    }
+
+    if(bytes > 0 && rates[LIM_HOST_BYTES] && (w = bucket_take(&(host->bytes), rates[LIM_HOST_BYTES], bytes, now)) > wait) {
+        wait = w;
+    }
+
+    if(reqs > 0 && rates[LIM_REQS] && (w = bucket_take(&(lim->state->reqs), rates[LIM_REQS], reqs, now)) > wait) {
+        wait = w;
+    }
+
+    if(reqs > 0 && rates[LIM_HOST_REQS] && (w = bucket_take(&(host->reqs), rates[LIM_HOST_REQS], reqs, now)) > wait) {
+        wait = w;
+    }
+
+    limiter_unlock(lim);
+
+    return wait;
+}
+
+
+/**
+ * @brief Sleeps for given time, but at most until the deadline
+ */
+void limiter_sleep(uint64_t ms, uint64_t deadline) {
+    uint64_t until = mono_ms() + ms;
+    if(deadline && deadline < until) {
+        until = deadline;
+    }
+
+    uint64_t now;
+    while((now = mono_ms()) < until) { //< Poll is used also for short delays (interruption by signal just restarts it)
+        poll(NULL, 0, (int)(until - now));
+    }
+}
+
+
+/**
+ * @brief Maps the state of buckets from the limit file (it is initialized if it is not valid)
+ */
+int limiter_map(limiter_t *lim, char *path) {
+    if((lim->fd = open(path, O_RDWR | O_CREAT, 0644)) < 0) {
+        printerr(FILE_ERROR, "Nepodarilo se otevrit soubor se stavem omezeni '%s'!", path);
+        return FILE_ERROR;
+    }
+
+    limiter_lock(lim); //< Other instance can initialize the file at the same time
+
+    struct stat st;
+    void *mapped = MAP_FAILED;
+    if(fstat(lim->fd, &st) == 0 && ((size_t)st.st_size >= sizeof(limit_state_t) || ftruncate(lim->fd, sizeof(limit_state_t)) == 0)) {
+        mapped = mmap(NULL, sizeof(limit_state_t), PROT_READ | PROT_WRITE, MAP_SHARED, lim->fd, 0);
+    }
+
+    if(mapped == MAP_FAILED) {
+        limiter_unlock(lim);
+        printerr(FILE_ERROR, "Nepodarilo se namapovat soubor se stavem omezeni '%s'!", path);
+        return FILE_ERROR;
+    }
+
+    lim->state = (limit_state_t *)mapped;
+    if(lim->state->magic != LIMIT_MAGIC) { //< New (or corrupted) file
+        memset(lim->state, 0, sizeof(limit_state_t));
+        lim->state->magic = LIMIT_MAGIC;
+    }
+
+    limiter_unlock(lim);
+
+    return SUCCESS;
+}
+
+
+int limiter_init(limiter_t *lim, settings_t *settings) {
+    lim->state = NULL;
+    lim->fd = -1;
+    lim->host_hash = 0;
+    lim->credit = 0;
+
+    bool is_limited = false;
+    for(int i = 0; i < LIM_NUM; i++) {
+        lim->rates[i] = settings->limits[i];
+        is_limited = is_limited || lim->rates[i];
+    }
+
+    if(!is_limited) { //< Limiter does nothing (limit file is not needed)
+        return SUCCESS;
+    }
+
+    if(settings->limit_file) {
+        return limiter_map(lim, settings->limit_file);
+    }
+
+    lim->state = (limit_state_t *)calloc(1, sizeof(limit_state_t));
+    if(!lim->state) {
+        printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro omezeni rychlosti!");
+        return INTERNAL_ERROR;
+    }
+
+    lim->state->magic = LIMIT_MAGIC;
+
+    return SUCCESS;
+}
+
+
+void limiter_select_host(limiter_t *lim, const char *host) {
+    char lower[MAX_HOST_LEN + 1];
+    size_t len = strlen(host) < MAX_HOST_LEN ? strlen(host) : MAX_HOST_LEN;
+    for(size_t i = 0; i < len; i++) { //< Host names are case insensitive
+        lower[i] = (char)tolower((unsigned char)host[i]);
+    }
+
+    uint64_t hash = hash_str(lower, len);
+    if(hash != lim->host_hash) { //< Credit was taken also from buckets of the previous host
+        lim->host_hash = hash;
+        lim->credit = 0;
+    }
+}
+
+
+void limiter_request(limiter_t *lim, uint64_t deadline) {
+    if(!lim->state || (!lim->rates[LIM_REQS] && !lim->rates[LIM_HOST_REQS])) {
+        return;
+    }
+
+    uint64_t wait = limiter_take(lim, 0, 1);
+    if(wait) {
+        limiter_sleep(wait, deadline);
+    }
+}
+
+
+bool limiter_try_request(limiter_t *lim) {
+    if(!lim->state || (!lim->rates[LIM_REQS] && !lim->rates[LIM_HOST_REQS])) {
+        return true;
+    }
+
+    uint64_t now = mono_ms();
+    bool is_allowed = true;
+
+    limiter_lock(lim);
+
+    limit_host_t *host = limiter_host(lim, now);
+    bucket_t *buckets[] = {&(lim->state->reqs), &(host->reqs)};
+    long rates[] = {lim->rates[LIM_REQS], lim->rates[LIM_HOST_REQS]};
+    for(int i = 0; i < 2; i++) {
+        if(rates[i]) {
+            bucket_refill(buckets[i], rates[i], now);
+            is_allowed = is_allowed && buckets[i]->tokens >= 1.0;
+        }
+    }
+
+    for(int i = 0; i < 2 && is_allowed; i++) {
+        if(rates[i]) {
+            buckets[i]->tokens -= 1.0;
+        }
+    }
+
+    limiter_unlock(lim);
+
+    return is_allowed;
+}
+
+
+void limiter_bytes(limiter_t *lim, size_t n, uint64_t deadline) {
+    if(!lim->state || (!lim->rates[LIM_BYTES] && !lim->rates[LIM_HOST_BYTES])) {
+        return;
+    }
+
+    if(lim->credit >= (double)n) { //< Fast path without locking
+        lim->credit -= (double)n;
+        return;
+    }
+
+    long rate = lim->rates[LIM_BYTES];
+    if(!rate || (lim->rates[LIM_HOST_BYTES] && lim->rates[LIM_HOST_BYTES] < rate)) {
+        rate = lim->rates[LIM_HOST_BYTES];
+    }
+
+    double quantum = (double)rate/LIMIT_QUANTUM_DIV;
+    if(quantum < (double)n - lim->credit) {
+        quantum = (double)n - lim->credit;
+    }
+
+    uint64_t wait = limiter_take(lim, quantum, 0);
+    lim->credit += quantum - (double)n;
+
+    if(wait) {
+        limiter_sleep(wait, deadline);
+    }
+}
+
+
+void limiter_dtor(limiter_t *lim) {
+    if(lim->fd >= 0) {
+        if(lim->state) {
+            munmap(lim->state, sizeof(limit_state_t));
+        }
+
+        close(lim->fd);
+    }
+    else {
+        free(lim->state);
+    }
+
+    lim->state = NULL;
+    lim->fd = -1;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file limit.h
+ * @brief Header file of module with limiter of rates of requests and
+ * transferred bytes (token buckets), the state of buckets can be shared by
+ * more instances through the limit file
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 11. 11. 2022
+ */
+
+#ifndef _FEEDREADER_LIMIT_
+#define _FEEDREADER_LIMIT_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <ctype.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#include "common.h"
+#include "cli.h"
+#include "url.h"
+
+
+#define LIMIT_MAGIC 0x46524c494d495431ULL //< Identifies initialized state in the limit file (it must be changed with layout of limit_state_t)
+#define LIMIT_HOST_SLOTS 256 //< Amount of buckets for hosts
+#define LIMIT_HOST_PROBES 8 //< Amount of slots, that are searched for the host (linear probing from its home slot)
+#define LIMIT_QUANTUM_DIV 50 //< Bytes are taken from shared buckets by quanta (1/LIMIT_QUANTUM_DIV of rate), so buckets are not locked for each chunk
+
+
+/**
+ * @brief Token bucket (tokens are added continuously, burst is amount of tokens for one second)
+ */
+typedef struct bucket {
+    double tokens; //< Available tokens (negative value is debt, that must be waited out)
+    uint64_t last; //< Time (in ms of monotonic clock) of the last refill (0 means full bucket)
+} bucket_t;
+
+
+/**
+ * @brief Buckets of one host
+ */
+typedef struct limit_host {
+    uint64_t hash; //< Hash of host, that owns the slot (other host replaces it only if both buckets are full)
+    bucket_t bytes;
+    bucket_t reqs;
+} limit_host_t;
+
+
+/**
+ * @brief State of all buckets (it is mapped from the limit file if it is shared)
+ */
+typedef struct limit_state {
+    uint64_t magic; //< LIMIT_MAGIC if the state was initialized
+    bucket_t bytes; //< Global buckets
+    bucket_t reqs;
+    limit_host_t hosts[LIMIT_HOST_SLOTS]; //< Buckets of hosts (indexed by hash of host)
+} limit_state_t;
+
+
+/**
+ * @brief Limiter of rates of requests and transferred bytes
+ * @note It is not thread safe (it is used only by the thread, that fetches sources)
+ */
+typedef struct limiter {
+    limit_state_t *state; //< State of buckets or NULL if rates are not limited
+    int fd; //< Descriptor of the limit file (it is locked during updates of state) or -1
+    long rates[LIM_NUM]; //< Limits from settings (0 means no limit)
+    uint64_t host_hash; //< Hash of the current host
+    double credit; //< Bytes already taken from buckets, that were not transferred yet
+} limiter_t;
+
+
+/**
+ * @brief Initializes limiter (if limit file is set, the state is mapped from
+ * it and it is initialized if it is not valid)
+ *
+ * @return int SUCCESS, FILE_ERROR or INTERNAL_ERROR
+ */
+int limiter_init(limiter_t *lim, settings_t *settings);
+
+
+/**
+ * @brief Sets the host, whose buckets are used by following requests and transfers
+ */
+void limiter_select_host(limiter_t *lim, const char *host);
+
+
+/**
+ * @brief Takes the token for the request to the current host (it waits until
+ * the rate is not exceeded, but at most until the deadline)
+ */
+void limiter_request(limiter_t *lim, uint64_t deadline);
+
+
+/**
+ * @brief Takes the token for the request to the current host without waiting
+ *
+ * @return true if the request may be sent
+ */
+bool limiter_try_request(limiter_t *lim);
+
+
+/**
+ * @brief Accounts transferred bytes (it waits until the rate is not exceeded,
+ * but at most until the deadline)
+ */
+void limiter_bytes(limiter_t *lim, size_t n, uint64_t deadline);
+
+
+/**
+ * @brief Frees resources of limiter (shared state is unmapped)
+ */
+void limiter_dtor(limiter_t *lim);
+
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file redir.c
+ * @brief Src file of module with memo of permanent redirections, that
+ * is kept across runs (in the memo file), so redirected URLs are rewritten
+ * without requests to their original locations
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 11. 11. 2022
+ */
+
+#include "redir.h"
+
+
+/**
+ * @brief Checks whether the string can be stored in the memo file (fields are separated by white spaces)
+ */
+bool redir_is_storable(const char *str, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        if(isspace((unsigned char)str[i])) {
+            return false;
+        }
+    }
+
+    return len > 0;
+}
+
+
+/**
+ * @brief Stores redirection with given expiration time to the table
+ */
+void redir_memo_set(redir_memo_t *memo, const char *key, size_t len, const char *target, int64_t expires) {
+    url_cache_entry_t *entry = url_cache_find(&(memo->tab), key, len);
+    if(!entry) {
+        entry = url_cache_insert(&(memo->tab), key, len);
+    }
+
+    char *target_copy = arena_strndup(&(memo->tab.strs), target, strlen(target));
+    if(!entry || !target_copy) {
+        return;
+    }
+
+    entry->redir = target_copy;
+    entry->expires = expires;
+}
+
+
+/**
+ * @brief Parses one line of the memo file (expiration time, canonical URL and target URL)
+ */
+void redir_memo_load_line(redir_memo_t *memo, char *line, int64_t now) {
+    char *cur = line, *end;
+
+    errno = 0;
+    long long expires = strtoll(cur, &end, 10);
+    if(errno || end == cur || expires <= now) { //< Expired redirections are dropped
+        memo->dirty = true;
+        return;
+    }
+
+    char *key = skip_w_spaces(end, true);
+    size_t key_len = strcspn(key, " \t\r\n");
+    char *target = skip_w_spaces(&(key[key_len]), true);
+    size_t target_len = strcspn(target, " \t\r\n");
+    if(!key_len || !target_len) {
+        memo->dirty = true;
+        return;
+    }
+
+    target[target_len] = '\0';
+    redir_memo_set(memo, key, key_len, target, (int64_t)expires);
+}
+
+
+void redir_memo_init(redir_memo_t *memo, char *path) {
+    url_cache_init(&(memo->tab));
+    memo->path = path;
+    memo->dirty = false;
+
+    if(!path) {
+        return;
+    }
+
+    FILE *f = fopen(path, "r");
+    if(!f) {
+        if(errno != ENOENT) { //< Missing file means, that there are no redirections yet
+            printw("Nepodarilo se nacist ulozena presmerovani ze souboru '%s'!", path);
+        }
+
+        return;
+    }
+
+    int64_t now = (int64_t)time(NULL);
+    char *line = NULL;
+    size_t size = 0;
+    while(getline(&line, &size, f) != -1) { //< URLs can be arbitrarily long
+        if(line[0] != '#') {
+            redir_memo_load_line(memo, line, now);
+        }
+    }
+
+    free(line);
+    fclose(f);
+}
+
+
+const char *redir_memo_find(redir_memo_t *memo, const char *key, size_t len) {
+    if(!memo->path) {
+        return NULL;
+    }
+
+    url_cache_entry_t *entry = url_cache_find(&(memo->tab), key, len);
+    if(!entry || !entry->redir || entry->expires <= (int64_t)time(NULL)) {
+        return NULL;
+    }
+
+    return entry->redir;
+}
+
+
+void redir_memo_put(redir_memo_t *memo, const char *key, size_t len, const char *target) {
+    if(!memo->path || !redir_is_storable(key, len) || !redir_is_storable(target, strlen(target))) {
+        return;
+    }
+
+    if(strlen(target) == len && !strncmp(key, target, len)) { //< Redirection to itself would be followed forever
+        return;
+    }
+
+    redir_memo_set(memo, key, len, target, (int64_t)time(NULL) + REDIR_MEMO_TTL_S);
+    memo->dirty = true;
+}
+
+
+int redir_memo_save(redir_memo_t *memo) {
+    if(!memo->path || !memo->dirty) {
+        return SUCCESS;
+    }
+
+    char tmp_path[FILENAME_MAX];
+    FILE *f = NULL;
+    if(snprintf(tmp_path, FILENAME_MAX, "%s.tmp", memo->path) >= FILENAME_MAX || !(f = fopen(tmp_path, "w"))) {
+        printw("Nepodarilo se ulozit presmerovani do souboru '%s'!", memo->path);
+        return FILE_ERROR;
+    }
+
+    int64_t now = (int64_t)time(NULL);
+    fprintf(f, "%s\n", REDIR_MEMO_HEADER);
+    fprintf(f, "# expires canonical_url target_url\n");
+    for(size_t i = 0; i < memo->tab.cap; i++) {
+        url_cache_entry_t *entry = &(memo->tab.slots[i]);
+        if(entry->key && entry->redir && entry->expires > now) {
+            fprintf(f, "%" PRId64 " %.*s %s\n", entry->expires, (int)entry->key_len, entry->key, entry->redir);
+        }
+    }
+
+    if(fclose(f) || rename(tmp_path, memo->path)) { //< Other runs see either old or new memo
+        remove(tmp_path);
+        printw("Nepodarilo se ulozit presmerovani do souboru '%s'!", memo->path);
+        return FILE_ERROR;
+    }
+
+    memo->dirty = false;
+
+    return SUCCESS;
+}
+
+
+void redir_memo_dtor(redir_memo_t *memo) {
+    url_cache_dtor(&(memo->tab));
+}
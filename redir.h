@@ -0,0 +1,87 @@
+/**
+ * @file redir.h
+ * @brief Header file of module with memo of permanent redirections, that
+ * is kept across runs (in the memo file), so redirected URLs are rewritten
+ * without requests to their original locations
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 11. 11. 2022
+ */
+
+#ifndef _FEEDREADER_REDIR_
+#define _FEEDREADER_REDIR_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "common.h"
+#include "cli.h"
+
+
+#define REDIR_MEMO_TTL_S (24*3600) //< Time in seconds, for which the permanent redirection is used without checking it
+#define REDIR_MEMO_HEADER "# feedreader permanent redirections v1" //< The first line of the memo file
+
+
+/**
+ * @brief Memo of permanent redirections (canonical URL -> target URL)
+ * @note It is not thread safe (it is used only by the thread, that fetches sources)
+ */
+typedef struct redir_memo {
+    url_cache_t tab; //< Table with redirections (target is in redir of entry)
+    char *path; //< Path to the memo file (or NULL if redirections are not remembered)
+    bool dirty; //< Flag signalizing, that memo was changed and it should be saved
+} redir_memo_t;
+
+
+/**
+ * @brief Initializes memo and loads the memo file (missing file means empty
+ * memo, invalid and expired lines are ignored)
+ *
+ * @param path Path to the memo file or NULL (then the memo does nothing)
+ */
+void redir_memo_init(redir_memo_t *memo, char *path);
+
+
+/**
+ * @brief Finds the target of permanent redirection of URL
+ *
+ * @param key Canonical form of URL
+ * @param len Length of the canonical form
+ * @return const char* Target URL or NULL if there is no valid redirection
+ */
+const char *redir_memo_find(redir_memo_t *memo, const char *key, size_t len);
+
+
+/**
+ * @brief Stores permanent redirection of URL (the previous one is replaced)
+ *
+ * @param key Canonical form of URL
+ * @param len Length of the canonical form
+ * @param target Absolute URL, to which the URL was redirected
+ */
+void redir_memo_put(redir_memo_t *memo, const char *key, size_t len, const char *target);
+
+
+/**
+ * @brief Writes valid redirections to the file (if memo was changed), the file
+ * is replaced atomically
+ *
+ * @return int SUCCESS or FILE_ERROR
+ */
+int redir_memo_save(redir_memo_t *memo);
+
+
+/**
+ * @brief Frees resources of memo (it is not saved)
+ */
+void redir_memo_dtor(redir_memo_t *memo);
+
+
+#endif
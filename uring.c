@@ -0,0 +1,433 @@
+/**
+ * @file uring.c
+ * @brief Src file of module with minimal io_uring backend (rings are set up
+ * by raw syscalls, so there is no dependency on liburing)
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 5. 11. 2022
+ */
+
+#include "uring.h"
+
+
+#ifdef URING_SUPPORTED
+
+
+int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+
+/**
+ * @brief Checks whether kernel supports all operations, that are used for loading of files
+ */
+bool uring_probe(uring_t *ring) {
+    int needed_ops[] = { IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE };
+
+    size_t probe_size = sizeof(struct io_uring_probe) + IORING_OP_LAST*sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe *)calloc(1, probe_size);
+    if(!probe) {
+        return false;
+    }
+
+    bool supported = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) >= 0;
+    for(size_t i = 0; supported && i < sizeof(needed_ops)/sizeof(int); i++) {
+        supported = needed_ops[i] <= probe->last_op && (probe->ops[needed_ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    free(probe);
+
+    return supported;
+}
+
+
+bool uring_init(uring_t *ring, unsigned entries) {
+    memset(ring, 0, sizeof(uring_t));
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(struct io_uring_params));
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if(ring->fd < 0) { //< Kernel without io_uring (or it is forbidden)
+        ring->fd = -1;
+        return false;
+    }
+
+    ring->sq_ring_len = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    ring->cq_ring_len = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+    ring->sqes_len = params.sq_entries*sizeof(struct io_uring_sqe);
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        uring_dtor(ring);
+        return false;
+    }
+
+    char *sq_ring = (char *)ring->sq_ring, *cq_ring = (char *)ring->cq_ring;
+    ring->sq_head = (unsigned *)(sq_ring + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq_ring + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq_ring + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq_ring + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq_ring + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq_ring + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq_ring + params.cq_off.ring_mask);
+    ring->cqes = (void *)(cq_ring + params.cq_off.cqes);
+
+    if(!uring_probe(ring)) {
+        uring_dtor(ring);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Returns the next free submission queue entry (or NULL if the queue is full)
+ */
+struct io_uring_sqe *uring_get_sqe(uring_t *ring, int op, size_t file_i) {
+    static const __u8 opcodes[] = {
+        [URING_STAT] = IORING_OP_STATX,
+        [URING_OPEN] = IORING_OP_OPENAT,
+        [URING_READ] = IORING_OP_READ,
+        [URING_CLOSE] = IORING_OP_CLOSE,
+    };
+
+    unsigned tail = *(ring->sq_tail) + ring->pending; //< Tail is modified only by this process
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if(tail - head > *(ring->sq_mask)) {
+        return NULL;
+    }
+
+    unsigned index = tail & *(ring->sq_mask);
+    struct io_uring_sqe *sqe = &(((struct io_uring_sqe *)ring->sqes)[index]);
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = opcodes[op];
+    sqe->user_data = ((__u64)file_i << URING_OP_BITS) | (__u64)op;
+
+    ring->sq_array[index] = index;
+    ring->pending++;
+
+    return sqe;
+}
+
+
+/**
+ * @brief Submits all prepared entries and waits for (at least) given amount of completions
+ */
+bool uring_submit(uring_t *ring, unsigned wait_nr) {
+    unsigned to_submit = ring->pending;
+    __atomic_store_n(ring->sq_tail, *(ring->sq_tail) + to_submit, __ATOMIC_RELEASE);
+    ring->pending = 0;
+
+    while(to_submit > 0) {
+        int ret = uring_enter(ring->fd, to_submit, wait_nr, IORING_ENTER_GETEVENTS);
+        if(ret < 0 && errno == EINTR) {
+            continue;
+        }
+        else if(ret <= 0) {
+            return false;
+        }
+
+        to_submit -= (unsigned)ret;
+        ring->inflight += (unsigned)ret;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Stores result of one completed operation to the corresponding file
+ */
+void uring_complete(uring_file_t *files, struct io_uring_cqe *cqe) {
+    uring_file_t *file = &(files[cqe->user_data >> URING_OP_BITS]);
+    int op = (int)(cqe->user_data & ((1 << URING_OP_BITS) - 1));
+
+    if(op == URING_CLOSE) { //< Descriptor is released even if closing failed
+        file->fd = -1;
+    }
+
+    if(cqe->res < 0) {
+        if(op != URING_CLOSE && !file->err) { //< First error is preserved (result of closing is not important)
+            file->err = -cqe->res;
+        }
+
+        return;
+    }
+
+    switch(op) {
+        case URING_OPEN:
+            file->fd = cqe->res;
+            break;
+        case URING_READ:
+            file->len = (size_t)cqe->res;
+            break;
+        default:
+            break;
+    }
+}
+
+
+/**
+ * @brief Processes given amount of completions (it waits for them if they are not available)
+ */
+bool uring_reap(uring_t *ring, uring_file_t *files, unsigned expected) {
+    struct io_uring_cqe *cqes = (struct io_uring_cqe *)ring->cqes;
+
+    while(expected > 0) {
+        unsigned head = *(ring->cq_head);
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        if(head == tail) {
+            if(uring_enter(ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                return false;
+            }
+
+            continue;
+        }
+
+        for(; head != tail && expected > 0; head++, expected--) {
+            uring_complete(files, &(cqes[head & *(ring->cq_mask)]));
+            ring->inflight--;
+        }
+
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Waits for completions of all submitted operations after error of
+ * io_uring (kernel could still write to the files meanwhile and descriptors
+ * opened by them would leak)
+ */
+void uring_drain(uring_t *ring, uring_file_t *files) {
+    while(ring->inflight > 0 && !uring_reap(ring, files, ring->inflight)) {
+        if(errno != EAGAIN && errno != EBUSY) { //< Completions cannot be waited for at all
+            break;
+        }
+    }
+}
+
+
+/**
+ * @brief Submits prepared entries and processes all their completions (if
+ * it fails, completions of already submitted entries are still processed)
+ */
+bool uring_run(uring_t *ring, uring_file_t *files) {
+    unsigned submitted = ring->pending;
+    if(submitted == 0) {
+        return true;
+    }
+
+    if(!uring_submit(ring, submitted) || !uring_reap(ring, files, submitted)) {
+        uring_drain(ring, files);
+        return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Reads the rest of the file synchronously (in case of short read)
+ */
+void uring_finish_read(uring_file_t *file, size_t size) {
+    while(file->len < size) {
+        ssize_t newly_read_b = pread(file->fd, file->data + file->len, size - file->len, (off_t)file->len);
+        if(newly_read_b < 0 && errno == EINTR) {
+            continue;
+        }
+        else if(newly_read_b < 0) {
+            file->err = errno;
+            break;
+        }
+        else if(newly_read_b == 0) { //< File was truncated meanwhile
+            break;
+        }
+
+        file->len += (size_t)newly_read_b;
+    }
+}
+
+
+/**
+ * @brief Closes all opened files of the batch synchronously (when io_uring fails)
+ */
+void uring_close_files(uring_file_t *files, size_t num) {
+    for(size_t i = 0; i < num; i++) {
+        if(files[i].fd >= 0) {
+            close(files[i].fd);
+            files[i].fd = -1;
+        }
+    }
+}
+
+
+bool uring_load_files(uring_t *ring, uring_file_t *files, size_t num) {
+    if(num > URING_BATCH_SIZE || ring->fd < 0) {
+        return false;
+    }
+
+    for(size_t i = 0; i < num; i++) { //< Stat and open all files at once
+        files[i].fd = -1;
+        files[i].err = 0;
+        files[i].len = 0;
+
+        struct io_uring_sqe *stat_sqe = uring_get_sqe(ring, URING_STAT, i);
+        struct io_uring_sqe *open_sqe = uring_get_sqe(ring, URING_OPEN, i);
+        if(!stat_sqe || !open_sqe) {
+            return false;
+        }
+
+        stat_sqe->fd = AT_FDCWD;
+        stat_sqe->addr = (__u64)(uintptr_t)files[i].path;
+        stat_sqe->len = STATX_TYPE | STATX_SIZE;
+        stat_sqe->off = (__u64)(uintptr_t)&(files[i].stx);
+
+        open_sqe->fd = AT_FDCWD;
+        open_sqe->addr = (__u64)(uintptr_t)files[i].path;
+        open_sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    }
+
+    if(!uring_run(ring, files)) {
+        uring_close_files(files, num); //< Some files may be opened even if there was an error
+        return false;
+    }
+
+    for(size_t i = 0; i < num; i++) { //< Read whole content of all files at once
+        uring_file_t *file = &(files[i]);
+        if(file->err || file->fd < 0) {
+            continue;
+        }
+        else if(!S_ISREG(file->stx.stx_mode)) {
+            file->err = EINVAL;
+            continue;
+        }
+
+        size_t size = (size_t)file->stx.stx_size;
+        if(size > file->cap || !file->data) { //< Buffers are reused, so they are only enlarged
+            char *new_data = (char *)realloc(file->data, size ? size : 1);
+            if(!new_data) {
+                file->err = ENOMEM;
+                continue;
+            }
+
+            file->data = new_data;
+            file->cap = size ? size : 1;
+        }
+
+        if(size == 0) {
+            continue;
+        }
+
+        struct io_uring_sqe *read_sqe = uring_get_sqe(ring, URING_READ, i);
+        if(!read_sqe) {
+            uring_close_files(files, num);
+            return false;
+        }
+
+        read_sqe->fd = file->fd;
+        read_sqe->addr = (__u64)(uintptr_t)file->data;
+        read_sqe->len = (__u32)(size < 0x7ffff000 ? size : 0x7ffff000); //< Maximum of one read (the rest is read by pread)
+        read_sqe->off = 0;
+    }
+
+    if(!uring_run(ring, files)) {
+        uring_close_files(files, num);
+        return false;
+    }
+
+    for(size_t i = 0; i < num; i++) { //< Finish short reads and close all files at once
+        uring_file_t *file = &(files[i]);
+        if(file->fd < 0) {
+            continue;
+        }
+
+        if(!file->err && S_ISREG(file->stx.stx_mode)) {
+            uring_finish_read(file, (size_t)file->stx.stx_size);
+        }
+
+        struct io_uring_sqe *close_sqe = uring_get_sqe(ring, URING_CLOSE, i);
+        if(!close_sqe) {
+            close(file->fd);
+            file->fd = -1;
+        }
+        else { //< Descriptor is released by the completion of closing
+            close_sqe->fd = file->fd;
+        }
+    }
+
+    if(!uring_run(ring, files)) {
+        uring_close_files(files, num); //< Files, whose closing was not submitted
+        return false;
+    }
+
+    return true;
+}
+
+
+void uring_dtor(uring_t *ring) {
+    if(ring->sq_ring && ring->sq_ring != MAP_FAILED) {
+        munmap(ring->sq_ring, ring->sq_ring_len);
+    }
+
+    if(ring->cq_ring && ring->cq_ring != MAP_FAILED) {
+        munmap(ring->cq_ring, ring->cq_ring_len);
+    }
+
+    if(ring->sqes && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_len);
+    }
+
+    if(ring->fd >= 0) {
+        close(ring->fd);
+    }
+
+    memset(ring, 0, sizeof(uring_t));
+    ring->fd = -1;
+}
+
+
+#else
+
+
+bool uring_init(uring_t *ring, unsigned entries) {
+    (void)entries;
+
+    memset(ring, 0, sizeof(uring_t));
+    ring->fd = -1;
+
+    return false;
+}
+
+
+bool uring_load_files(uring_t *ring, uring_file_t *files, size_t num) {
+    (void)ring;
+    (void)files;
+    (void)num;
+
+    return false;
+}
+
+
+void uring_dtor(uring_t *ring) {
+    memset(ring, 0, sizeof(uring_t));
+    ring->fd = -1;
+}
+
+
+#endif
+
+
+void uring_files_dtor(uring_file_t *files, size_t num) {
+    for(size_t i = 0; i < num; i++) {
+        free(files[i].data);
+        files[i].data = NULL;
+        files[i].cap = 0;
+    }
+}
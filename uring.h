@@ -0,0 +1,117 @@
+/**
+ * @file uring.h
+ * @brief Header file of module with minimal io_uring backend (without
+ * liburing), that is used for batched loading of local files
+ *
+ * @author Vojtěch Dvořák (xdvora3o)
+ * @date 5. 11. 2022
+ */
+
+#ifndef _FEEDREADER_URING_
+#define _FEEDREADER_URING_
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+    #define URING_SUPPORTED //< io_uring can be used (but it still may be disabled by the kernel)
+    #include <linux/io_uring.h>
+    #include <linux/stat.h>
+#endif
+
+
+#define URING_BATCH_SIZE 32 //< Maximum amount of files, that are loaded by one batch
+#define URING_OP_BITS 2 //< Amount of bits of user data of entry, that are used for the type of operation
+
+
+/**
+ * @brief Types of operations submitted to io_uring (they are stored in the
+ * lowest bits of user data, the rest is index of file)
+ */
+enum uring_ops {
+    URING_STAT,
+    URING_OPEN,
+    URING_READ,
+    URING_CLOSE,
+};
+
+
+/**
+ * @brief Submission and completion queues of io_uring instance mapped to the memory
+ */
+typedef struct uring {
+    int fd; //< File descriptor of io_uring instance (-1 if it is not initialized)
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    void *sq_ring, *cq_ring, *sqes, *cqes; //< Mapped regions (cqes points into cq_ring)
+    size_t sq_ring_len, cq_ring_len, sqes_len;
+    unsigned pending; //< Amount of submission queue entries, that were not submitted yet
+    unsigned inflight; //< Amount of submitted operations, whose completions were not processed yet
+} uring_t;
+
+
+/**
+ * @brief Local file loaded by the batch
+ */
+typedef struct uring_file {
+    char *path; //< Path to the file (it is not owned by the structure)
+    char *data; //< Content of the file (buffer is reused by following batches)
+    size_t cap; //< Capacity of the data buffer
+    size_t len; //< Length of the content
+    int fd; //< Descriptor of opened file (it is used only during loading)
+    int err; //< Zero or errno if file cannot be loaded
+#ifdef URING_SUPPORTED
+    struct statx stx; //< Attributes of the file (needed for the size of the file)
+#endif
+} uring_file_t;
+
+
+/**
+ * @brief Initializes io_uring instance, checks if all operations necessary
+ * for loading of files are supported by the kernel
+ *
+ * @param ring Ring to be initialized
+ * @param entries Capacity of the submission queue
+ * @return true if io_uring can be used, otherwise false (caller should use
+ * ordinary syscalls)
+ */
+bool uring_init(uring_t *ring, unsigned entries);
+
+
+/**
+ * @brief Loads whole content of files to their buffers by io_uring
+ * @note All files are stated and opened by one syscall, then read by one syscall
+ * and closed by one syscall (short reads are finished synchronously)
+ *
+ * @param ring Initialized ring with capacity at least 2*num entries
+ * @param files Files with paths to be loaded (results are in data, len and err)
+ * @param num Amount of files (at most URING_BATCH_SIZE)
+ * @return true if batch was processed, false if there was error of io_uring
+ * itself (content of files is undefined then)
+ */
+bool uring_load_files(uring_t *ring, uring_file_t *files, size_t num);
+
+
+/**
+ * @brief Frees data buffers of files
+ */
+void uring_files_dtor(uring_file_t *files, size_t num);
+
+
+/**
+ * @brief Unmaps the rings and closes io_uring instance
+ */
+void uring_dtor(uring_t *ring);
+
+
+#endif
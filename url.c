@@ -12,26 +12,59 @@
 
 void init_url(url_t *url) {
     for(int i = 0; i < RE_URL_NUM; i++) {
-        url->url_parts[i] = NULL;
+        url->url_parts[i] = new_str_slice("", 0);
+        url->owned[i] = NULL;
     }
 
+    url->explicit_port = false;
     url->type = UNKNOWN;
 }
 
 
 void erase_url(url_t *url) {
     for(int i = 0; i < RE_URL_NUM; i++) {
-        erase_string(url->url_parts[i]);
+        url->url_parts[i] = new_str_slice("", 0); //< Owned buffers are kept for the next URL
     }
+
+    url->explicit_port = false;
+    url->type = UNKNOWN;
 }
 
 
 void url_dtor(url_t *url) {
     for(int i = 0; i < RE_URL_NUM; i++) {
-        if(url->url_parts[i]) {
-            string_dtor(url->url_parts[i]);
+        if(url->owned[i]) {
+            string_dtor(url->owned[i]);
+            url->owned[i] = NULL;
+        }
+    }
+}
+
+
+char *url_part_cstr(url_t *url, int part, char *buff, size_t size) {
+    string_slice_t *slice = &(url->url_parts[part]);
+    if(slice->len >= size) {
+        return NULL;
+    }
+
+    memcpy(buff, slice->st, slice->len);
+    buff[slice->len] = '\0';
+
+    return buff;
+}
+
+
+/**
+ * @brief Appends content of slice to the string
+ */
+string_t *app_slice(string_t **dest, string_slice_t *slice) {
+    for(size_t i = 0; i < slice->len; i++) {
+        if(!app_char(dest, slice->st[i])) {
+            return NULL;
         }
     }
+
+    return *dest;
 }
 
 
@@ -55,22 +88,6 @@ void free_all_url_patterns(regex_t *regexes) {
 }
 
 
-/**
- * @brief Checks whether string contains only numbers
- */
-bool is_numeric_str(char *str) {
-    size_t i = 0;
-    for(; str[i] && (str[i] >= '0' && str[i] <= '9'); i++);
-
-    if(i == strlen(str) - 1) {
-        return true;
-    }
-    else {
-        return false;
-    }
-}
-
-
 /**
  * @brief Removes the last segment of path (file name) from path 
  */
@@ -87,51 +104,55 @@ void rem_file_from_path(char *path) {
 }
 
 
-string_t *replace_path(string_t *orig_url, string_t *path) {
+string_t *replace_path(char *orig_url, string_t *path) {
     url_t url;
     init_url(&url);
 
-    string_t *new_url = new_string(INIT_STRING_SIZE);
-    if(!new_url) {
+    int ret = parse_url(orig_url, &url);
+    if(ret != SUCCESS) { //< We ignore return codes because orig url should be already checked
+        url_dtor(&url);
         return NULL;
     }
 
-    int ret = parse_url(orig_url->str, &url);
-    if(ret != SUCCESS) { //< We ignore return codes because orig url should be already checked
+    string_t *new_url = new_string(INIT_STRING_SIZE);
+    if(!new_url) {
+        url_dtor(&url);
         return NULL;
     }
 
     for(int i = 0; i < PATH; i++) {
-        if(!is_empty(url.url_parts[i])) {
-            if(i == PORT_PART && !is_numeric_str(url.url_parts[i]->str)) {
+        if(url.url_parts[i].len > 0) {
+            if(i == PORT_PART && !url.explicit_port) { //< Default port is given by scheme
                 continue;
             }
             else if(i == PORT_PART) {
                 if(!app_string(&new_url, ":")) {
                     url_dtor(&url);
+                    string_dtor(new_url);
                     return NULL;
                 }
             }
 
-            if(!app_string(&new_url, url.url_parts[i]->str)) {
+            if(!app_slice(&new_url, &(url.url_parts[i]))) {
                 url_dtor(&url);
+                string_dtor(new_url);
                 return NULL;
             }
         }
     }
 
     if(path->str[0] != '/') { //< Path is relative
-        if(!is_empty(url.url_parts[PATH])) {
-            if(!app_string(&new_url, url.url_parts[PATH]->str)) {
-                url_dtor(&url);
-                return NULL;
-            }
+        if(!app_slice(&new_url, &(url.url_parts[PATH]))) {
+            url_dtor(&url);
+            string_dtor(new_url);
+            return NULL;
         }
         rem_file_from_path(new_url->str);
     }
 
     if(!app_string(&new_url, path->str)) { //< Append new path
         url_dtor(&url);
+        string_dtor(new_url);
         return NULL;
     }
 
@@ -181,19 +202,28 @@ int is_path(bool *result, char *str) {
 }
 
 
+/**
+ * @brief Compares scheme in the URL with given scheme (case insensitive)
+ */
+bool is_scheme(string_slice_t *scheme, const char *name) {
+    return scheme->len == strlen(name) && !strncasecmp(scheme->st, name, scheme->len);
+}
+
+
 //Converts scheme to enum values (it is more program-friendly format)
-int get_src_type(char *scheme) {
-    if(scheme == NULL) {
-        scheme = DEFAULT_URL_SCHEME;
+int get_src_type(string_slice_t *scheme) {
+    string_slice_t def_scheme = new_str_slice(DEFAULT_URL_SCHEME, strlen(DEFAULT_URL_SCHEME));
+    if(scheme == NULL || scheme->len == 0) {
+        scheme = &def_scheme;
     }
 
-    if(!strcasecmp(scheme, "file://")) {
+    if(is_scheme(scheme, "file://")) {
         return FILE_SRC;
     }
-    else if(!strcasecmp(scheme, "https://")) {
+    else if(is_scheme(scheme, "https://")) {
         return HTTPS_SRC;
     }
-    else if(!strcasecmp(scheme, "http://")) {
+    else if(is_scheme(scheme, "http://")) {
         return HTTP_SRC;
     }
     else {
@@ -202,6 +232,14 @@ int get_src_type(char *scheme) {
 }
 
 
+/**
+ * @brief Returns the default port (service name) for given type of source 
+ */
+char *get_default_port(src_type_t type) {
+    return type == HTTP_SRC ? "http" : "https";
+}
+
+
 int prepare_url_patterns(regex_t *regexes) {
     //Patterns are based on RFC3986
     //http-URI = "http" "://" authority path-abempty [ "?" query ] ("#" [fragment]) (see RFC9110)
@@ -233,20 +271,16 @@ int prepare_url_patterns(regex_t *regexes) {
  * possible edge cases it does not result in error)
  */
 
-int res_url(bool is_inv, bool int_err, int *res, url_t *p_url, char *url) {
-    if(int_err) {
-        printerr(INTERNAL_ERROR, "Chyba pri analyze URL!");
-        return INTERNAL_ERROR;
-    }
-
+int res_url(bool is_inv, int *res, url_t *p_url, char *url) {
     if(res[SCHEME_PART] == REG_NOMATCH) { //< Non-strict parsing
         printw("Nebylo mozne najit platne schema URL v '%s'! URL bude automaticky doplnena o vychozi schema ('%s')!", url, DEFAULT_URL_SCHEME);
         p_url->type = get_src_type(NULL);
     }
-    else if(!is_empty(p_url->url_parts[SCHEME_PART])) { //< Check whether is scheme supported
-        p_url->type = get_src_type(p_url->url_parts[SCHEME_PART]->str);
+    else if(p_url->url_parts[SCHEME_PART].len > 0) { //< Check whether is scheme supported
+        string_slice_t *scheme = &(p_url->url_parts[SCHEME_PART]);
+        p_url->type = get_src_type(scheme);
         if(p_url->type == UNKNOWN) {
-            printerr(URL_ERROR, "Nepodporovane schema '%s' adresy '%s'!", p_url->url_parts[SCHEME_PART]->str, url);
+            printerr(URL_ERROR, "Nepodporovane schema '%.*s' adresy '%s'!", (int)scheme->len, scheme->st, url);
             return URL_ERROR;
         }
     }
@@ -264,7 +298,8 @@ int res_url(bool is_inv, bool int_err, int *res, url_t *p_url, char *url) {
         }
 
         if(res[USER_INFO_PART] != REG_NOMATCH) {
-            printw("Zastarala autentizacni cast '%s' byla nalezena v '%s'! Bude ignorovana!", p_url->url_parts[USER_INFO_PART]->str, url);
+            string_slice_t *user_info = &(p_url->url_parts[USER_INFO_PART]);
+            printw("Zastarala autentizacni cast '%.*s' byla nalezena v '%s'! Bude ignorovana!", (int)user_info->len, user_info->st, url);
         }
     }
 
@@ -272,65 +307,84 @@ int res_url(bool is_inv, bool int_err, int *res, url_t *p_url, char *url) {
 }
 
 
-int ins_perc_encoded(string_t **dst, size_t index, char c) {
-    char tmp[4];
-
-    snprintf(tmp, 4, "%hhX", c);
+/**
+ * @brief Returns the length of sequence at the start of given string, that
+ * can be in the part of URL without percent encoding (0 if the first 
+ * character must be encoded)
+ * @note Allowed characters are based on PATH_ABS_STRICT, QUERY_STRICT and 
+ * FRAG_STRICT (see RFC3986)
+ */
+size_t allowed_seq_len(const char *str, size_t len, int part) {
+    unsigned char c = str[0];
 
-    rm_char(*dst, index);
-    
-    if(!ins_char(dst, index, '%') || 
-        !ins_char(dst, index + 1, tmp[0]) || 
-        !ins_char(dst, index + 2, tmp[1])) {
-        printerr(INTERNAL_ERROR, "Nepodarilo se provest zakodovani znaku!");
-        return INTERNAL_ERROR;
+    if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) { //< Unreserved
+        return 1;
+    }
+    else if(c && strchr("._~-" "@!$&'()*+,;=" ":@/", c)) { //< Unreserved, sub-delims, pchar and '/'
+        return 1;
+    }
+    else if(c == '?' && part != PATH) { //< Question mark is allowed in query and in fragment
+        return 1;
+    }
+    else if(c == '%' && len >= 3 && isxdigit((unsigned char)str[1]) && isxdigit((unsigned char)str[2])) { //< Already encoded
+        return 3;
     }
 
-    return SUCCESS;
+    return 0;
 }
 
 
 /**
- * @brief Performs percent encoding of input (preserves characters/sequences allowed by pattern) 
+ * @brief Performs percent encoding of the part of URL (preserves characters/sequences allowed in this part)
+ * @note If there is nothing to encode (the most common case), the part 
+ * remains slice of the original URL and no memory is allocated 
  * @note Tested mainly with UTF-8 (all inputs should be firstly converted to UTF-8 due to RFC3986)
  */
-int perc_enc(string_t **src, const char *pattern) {
-    regex_t reg;
-    regmatch_t match;
-    int ret;
+int perc_enc(url_t *p_url, int part) {
+    static const char hexdig[] = "0123456789ABCDEF";
 
-    if(regcomp(&reg, pattern, REG_EXTENDED | REG_ICASE)) { //< We will need extended posix notation and case insensitive matching 
-        printerr(INTERNAL_ERROR, "Neplatna kompilace regularniho vyrazu! %d");
-        return INTERNAL_ERROR;
+    string_slice_t *src = &(p_url->url_parts[part]);
+    size_t i = part == PATH ? 0 : 1, n; //< Query and fragment start with delimiter ('?' or '#')
+    while(i < src->len && (n = allowed_seq_len(&(src->st[i]), src->len - i, part))) {
+        i += n;
+    }
+
+    if(i >= src->len) { //< Whole part is valid
+        return SUCCESS;
     }
 
-    size_t match_end = 0;
-    while(match_end < strlen((*src)->str)) { //< If there are any unallowed characters (regex deos not match the entire string)
-        int res = regexec(&reg, (*src)->str, 1, &match, 0);
-        if(res == REG_NOMATCH) {
-            return SUCCESS;
+    string_t **dst = &(p_url->owned[part]);
+    size_t needed = i + (src->len - i)*strlen("%XX") + 1; //< The worst case is, that every remaining character must be encoded
+    if(!*dst || (*dst)->size < needed) {
+        if(*dst) {
+            string_dtor(*dst);
         }
-        else {
-            match_end = match.rm_eo;
-            if(match_end < strlen((*src)->str)) {
-                char cur_char = (*src)->str[match_end];
-                if((ret = ins_perc_encoded(src, match_end, cur_char)) != SUCCESS) {
-                    return ret;
-                }
-                
-                if((cur_char & 0xC0) == 0xC0) { //< UTF-8 multibyte
-                    for(int i = 3; ((cur_char = (*src)->str[match_end + i]) & 0xC0) == 0x80; i++) {
-                        if((ret = ins_perc_encoded(src, match_end + i, cur_char)) != SUCCESS) {
-                            return ret;
-                        }
-                        i+=2;
-                    }    
-                }
-            }
+
+        if(!(*dst = new_string(needed))) {
+            printerr(INTERNAL_ERROR, "Nepodarilo se provest zakodovani znaku!");
+            return INTERNAL_ERROR;
         }
     }
 
-    regfree(&reg);
+    char *out = (*dst)->str;
+    size_t out_len = i;
+    memcpy(out, src->st, i); //< Copy the valid prefix
+    while(i < src->len) {
+        if((n = allowed_seq_len(&(src->st[i]), src->len - i, part))) {
+            memcpy(&(out[out_len]), &(src->st[i]), n);
+            out_len += n;
+            i += n;
+        }
+        else { //< Every byte (also in UTF-8 multibyte sequences) is encoded separately
+            unsigned char c = src->st[i++];
+            out[out_len++] = '%';
+            out[out_len++] = hexdig[c >> 4];
+            out[out_len++] = hexdig[c & 0xF];
+        }
+    }
+
+    out[out_len] = '\0';
+    *src = new_str_slice(out, out_len);
 
     return SUCCESS;
 }
@@ -338,66 +392,49 @@ int perc_enc(string_t **src, const char *pattern) {
 
 /**
  * @brief Performs normalization of URL (addition of missing scheme, path, percent encoding...) 
+ * @note Default values are string literals, so normalization of URL, that 
+ * does not have to be percent encoded, does not allocate any memory
  */
 int normalize_url(url_t *p_url, char* def_scheme_part_str) {
-    string_t **url_parts = p_url->url_parts, **dst;
+    string_slice_t *url_parts = p_url->url_parts;
     int ret;
 
     if(p_url->type == FILE_SRC) { //< If it is file there is no need to normalization
         return SUCCESS;
     }
 
-    if(is_empty(url_parts[SCHEME_PART])) { //< If scheme is missing, it does not necessary mean error, it is just set to default scheme 
-        dst = &(p_url->url_parts[SCHEME_PART]);
-
-        url_parts[SCHEME_PART] = set_string(dst, def_scheme_part_str);
-        if(!p_url->url_parts[SCHEME_PART]) {
-            printerr(INTERNAL_ERROR, "Nepodrailo se alokovat pamet pro schema URL!");
-            return INTERNAL_ERROR;
-        }
+    if(url_parts[SCHEME_PART].len == 0) { //< If scheme is missing, it does not necessary mean error, it is just set to default scheme 
+        url_parts[SCHEME_PART] = new_str_slice(def_scheme_part_str, strlen(def_scheme_part_str));
     }
 
-    if(!is_empty(url_parts[PORT_PART])) {
-        trunc_string(url_parts[PORT_PART], ((int)strlen(":"))); //< Remove : from start
+    if(url_parts[PORT_PART].len > 0) { //< Remove : from start
+        url_parts[PORT_PART].st++;
+        url_parts[PORT_PART].len--;
     }
 
-    if(is_empty(url_parts[PORT_PART]) || !strlen(url_parts[PORT_PART]->str)) { //< If port number was not set, set it by scheme sign (then must be determined default port number for given service)
-        dst = &(url_parts[PORT_PART]);
-
-        url_parts[PORT_PART] = set_string(dst, url_parts[SCHEME_PART]->str);
-        if(!url_parts[PORT_PART]) {
-            printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro portove cislo!");
-            return INTERNAL_ERROR;
-        }
-
-        trunc_string(url_parts[PORT_PART], -((int)strlen("://"))); //< Remove :// from the end
+    p_url->explicit_port = url_parts[PORT_PART].len > 0;
+    if(!p_url->explicit_port) { //< If port number was not set, set it by scheme sign (then must be determined default port number for given service)
+        char *def_port = get_default_port(p_url->type);
+        url_parts[PORT_PART] = new_str_slice(def_port, strlen(def_port));
     }
 
-    string_to_lower(url_parts[PORT_PART]);
-
-    if(is_empty(url_parts[PATH])) { //< If path is not set (which is quite often situation), it is set to default path "/"
-        dst = &(url_parts[PATH]);
-
-        url_parts[PATH] = set_string(dst, "/");
-        if(!url_parts[PATH]) {
-            printerr(INTERNAL_ERROR, "Nepodarilo se alokovat pamet pro cestu!");
-            return INTERNAL_ERROR;
-        }
+    if(url_parts[PATH].len == 0) { //< If path is not set (which is quite often situation), it is set to default path "/"
+        url_parts[PATH] = new_str_slice(DEFAULT_URL_PATH, strlen(DEFAULT_URL_PATH));
     }
     else {
-        if((ret = perc_enc(&(url_parts[PATH]), PATH_ABS_STRICT)) != SUCCESS) { //< Due to RFCs - all characters that are not explicitly allowed should be percent encoded
+        if((ret = perc_enc(p_url, PATH)) != SUCCESS) { //< Due to RFCs - all characters that are not explicitly allowed should be percent encoded
             return ret;
         }
     }
 
-    if(!is_empty(url_parts[QUERY])) {
-        if((ret = perc_enc(&(url_parts[QUERY]), QUERY_STRICT)) != SUCCESS) {
+    if(url_parts[QUERY].len > 0) {
+        if((ret = perc_enc(p_url, QUERY)) != SUCCESS) {
             return ret;
         }
     }
 
-    if(!is_empty(url_parts[FRAG_PART])) {
-        if((ret = perc_enc(&(url_parts[FRAG_PART]), FRAG_STRICT)) != SUCCESS) {
+    if(url_parts[FRAG_PART].len > 0) {
+        if((ret = perc_enc(p_url, FRAG_PART)) != SUCCESS) {
             return ret;
         }
     }
@@ -405,7 +442,7 @@ int normalize_url(url_t *p_url, char* def_scheme_part_str) {
     #ifdef DEBUG //Prints all parts of normalized url
         fprintf(stderr, "Normalized url parts\ni\tstr\n");
         for(int i = 0; i < RE_URL_NUM; i++) {
-            fprintf(stderr, "%d\t%s\n", i, p_url->url_parts[i] ? p_url->url_parts[i]->str : NULL);
+            fprintf(stderr, "%d\t%.*s\n", i, (int)url_parts[i].len, url_parts[i].st);
         }
         fprintf(stderr, "\n");
     #endif
@@ -426,19 +463,13 @@ int parse_url(char *url, url_t *p_url) {
 
     init_url_res_arr(res);
     size_t glob_st = 0; //< Index from which the searching begins
-    bool is_invalid = false, int_err_occ = false;
-    for(int i = 0; i < RE_URL_NUM && !is_invalid && !int_err_occ; i++) {
+    bool is_invalid = false;
+    for(int i = 0; i < RE_URL_NUM && !is_invalid; i++) {
         res[i] = regexec(&regexes[i], &(url[glob_st]), 1, &(regmatch[i]), 0); //< Perform searching in the rest of the URL
         if(res[i] == 0) { //< Pattern was found in the rest of URL
             int st = regmatch[i].rm_so, end = regmatch[i].rm_eo;
 
-            string_t **dst = &(p_url->url_parts[i]);
-            size_t len = end - st;
-            char *st_ptr = &(url[glob_st + st]);
-            if(!(p_url->url_parts[i] = set_stringn(dst, st_ptr, len))) { //< Save matched part of the string
-                int_err_occ = true;
-                break;
-            }
+            p_url->url_parts[i] = new_str_slice(&(url[glob_st + st]), end - st); //< Save matched part of the string (without copying)
         
             glob_st += regmatch[i].rm_eo;
         }
@@ -455,13 +486,13 @@ int parse_url(char *url, url_t *p_url) {
         fprintf(stderr, "i\tres\tstart\tend\n");
         for(int i = 0; i < RE_URL_NUM; i++) {
             fprintf(stderr, "%d\t%d\t", i, res[i]);
-            if(res[i] == 0) fprintf(stderr, "%ld\t%ld\t%s", (size_t)regmatch[i].rm_so, (size_t)regmatch[i].rm_eo, p_url->url_parts[i]->str);
+            if(res[i] == 0) fprintf(stderr, "%ld\t%ld\t%.*s", (size_t)regmatch[i].rm_so, (size_t)regmatch[i].rm_eo, (int)p_url->url_parts[i].len, p_url->url_parts[i].st);
             fprintf(stderr, "\n");
         }
         fprintf(stderr, "\n");
     #endif
 
-    if((ret = res_url(is_invalid, int_err_occ, res, p_url, url)) != SUCCESS) { //< Resolving parsing results
+    if((ret = res_url(is_invalid, res, p_url, url)) != SUCCESS) { //< Resolving parsing results
         return ret;
     }
     if((ret = normalize_url(p_url, DEFAULT_URL_SCHEME)) != SUCCESS) { //< Perform auto fixes of URL
@@ -470,3 +501,93 @@ int parse_url(char *url, url_t *p_url) {
 
     return SUCCESS;
 }
+
+
+/**
+ * @brief Checks whether the port of normalized URL is the default port of its scheme
+ */
+bool is_default_port(url_t *p_url) {
+    string_slice_t *port = &(p_url->url_parts[PORT_PART]);
+    const char *def_num = p_url->type == HTTP_SRC ? "80" : "443";
+
+    return is_scheme(port, get_default_port(p_url->type)) || is_scheme(port, def_num);
+}
+
+
+size_t url_canon(url_t *p_url, string_t *dst) {
+    string_slice_t *url_parts = p_url->url_parts;
+    const char *scheme = p_url->type == FILE_SRC ? "file://" : p_url->type == HTTP_SRC ? "http://" : "https://";
+    bool with_port = p_url->type != FILE_SRC && !is_default_port(p_url);
+
+    size_t len = strlen(scheme) + url_parts[USER_INFO_PART].len + url_parts[HOST].len + 1 + 
+                 (with_port ? url_parts[PORT_PART].len : 0) + url_parts[PATH].len + url_parts[QUERY].len + url_parts[FRAG_PART].len;
+    while(dst->size <= len) {
+        if(!ext_string(dst)) {
+            return 0;
+        }
+    }
+
+    char *cur = dst->str;
+    cur += sprintf(cur, "%s%.*s", scheme, (int)url_parts[USER_INFO_PART].len, url_parts[USER_INFO_PART].st);
+    for(size_t i = 0; i < url_parts[HOST].len; i++) { //< Host names are case insensitive
+        *(cur++) = (char)tolower((unsigned char)url_parts[HOST].st[i]);
+    }
+
+    if(with_port) {
+        cur += sprintf(cur, ":%.*s", (int)url_parts[PORT_PART].len, url_parts[PORT_PART].st);
+    }
+
+    //< Fragment is kept, because it is part of the request target sent to the server
+    cur += sprintf(cur, "%.*s%.*s%.*s", (int)url_parts[PATH].len, url_parts[PATH].st, (int)url_parts[QUERY].len, url_parts[QUERY].st,
+                   (int)url_parts[FRAG_PART].len, url_parts[FRAG_PART].st);
+
+    return (size_t)(cur - dst->str);
+}
+
+
+src_type_t url_authority(const char *url, char *host, char *port) {
+    const char *sch_end = strstr(url, "://");
+    const char *auth = sch_end ? sch_end + strlen("://") : url;
+    string_slice_t scheme = new_str_slice((char *)url, sch_end ? (size_t)(auth - url) : 0);
+
+    src_type_t type = get_src_type(&scheme);
+    if(type != HTTP_SRC && type != HTTPS_SRC) {
+        return UNKNOWN;
+    }
+
+    size_t auth_len = strcspn(auth, "/?#");
+    const char *at = memchr(auth, '@', auth_len);
+    while(at) { //< Skip user info (until the last '@')
+        auth_len -= (size_t)(at + 1 - auth);
+        auth = at + 1;
+        at = memchr(auth, '@', auth_len);
+    }
+
+    const char *host_end = auth + auth_len;
+    if(auth[0] == '[') { //< IPv6 literal can contain ':'
+        host_end = memchr(auth, ']', auth_len);
+        host_end = host_end ? host_end + 1 : auth + auth_len;
+    }
+    else if(memchr(auth, ':', auth_len)) {
+        host_end = memchr(auth, ':', auth_len);
+    }
+
+    size_t host_len = (size_t)(host_end - auth);
+    size_t port_len = host_end < auth + auth_len ? auth_len - host_len - 1 : 0;
+    if(host_len == 0 || host_len > MAX_HOST_LEN || port_len > MAX_PORT_LEN) {
+        return UNKNOWN;
+    }
+
+    memcpy(host, auth, host_len);
+    host[host_len] = '\0';
+
+    if(port_len > 0) {
+        memcpy(port, host_end + 1, port_len);
+        port[port_len] = '\0';
+    }
+    else {
+        strcpy(port, get_default_port(type));
+    }
+
+    return type;
+}
@@ -22,6 +22,10 @@
 
 
 #define DEFAULT_URL_SCHEME "https://" //< Default scheme (it is added to URL if user provides URL without any scheme)
+#define DEFAULT_URL_PATH "/" //< Default path (if URL does not contain any path)
+
+#define MAX_HOST_LEN 255 //< Maximum length of host part of URL (see RFC1035)
+#define MAX_PORT_LEN 31 //< Maximum length of port (number or service name)
 
 //Regex macros for parsing URL
 //Based on RFC3986
@@ -90,9 +94,14 @@ enum re_path_indexes {
 /**
  * @brief Structure with parts of HTTP url
  * 
+ * Parts are slices of the analysed URL string (so the URL string must live
+ * as long as this structure is used), string literals (default values) or
+ * slices of the owned buffers (only if part had to be percent encoded)
  */
 typedef struct url {
-    string_t *url_parts[RE_URL_NUM];
+    string_slice_t url_parts[RE_URL_NUM]; //< Parts of URL (st is NULL if part is missing)
+    string_t *owned[RE_URL_NUM]; //< Buffers for rewritten parts (they are reused by next URLs)
+    bool explicit_port; //< Flag signalizing, that port was specified in the URL
     src_type_t type; //< Type of source (ATOM/RSS/XML)
 } url_t;
 
@@ -109,10 +118,41 @@ void init_url(url_t *url);
 void url_dtor(url_t *url);
 
 
+/**
+ * @brief Copies the part of URL to given buffer as null terminated string
+ * 
+ * @return char* Ptr to buffer or NULL if the part does not fit into it
+ */
+char *url_part_cstr(url_t *url, int part, char *buff, size_t size);
+
+
+/**
+ * @brief Writes canonical form of parsed (and normalized) URL to the string
+ * @note Scheme and host are lowercased and default port is omitted,
+ * so different spellings of the same resource have the same canonical form
+ * 
+ * @return size_t Length of canonical URL or 0 if there is not enough memory
+ */
+size_t url_canon(url_t *p_url, string_t *dst);
+
+
+/**
+ * @brief Quickly extracts host and port from HTTP(S) URL without its full 
+ * analysis (it is used only as a hint, e. g. for resolving hosts in advance)
+ * 
+ * @param url URL
+ * @param host Output buffer for host (with size at least MAX_HOST_LEN + 1)
+ * @param port Output buffer for port (with size at least MAX_PORT_LEN + 1)
+ * @return src_type_t HTTP_SRC or HTTPS_SRC if URL has HTTP(S) scheme and its
+ * host was found, otherwise UNKNOWN
+ */
+src_type_t url_authority(const char *url, char *host, char *port);
+
+
 /**
  * @brief Replaces path in given original URL
  */
-string_t *replace_path(string_t *orig_url, string_t *path);
+string_t *replace_path(char *orig_url, string_t *path);
 
 
 /**